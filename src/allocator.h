@@ -0,0 +1,16 @@
+#pragma once
+
+#include "internal/hash/allocator.h"
+
+namespace fgpl {
+
+// Allocators for the buckets of the hash containers, given as their last template argument.
+template <class T>
+using HugePageAllocator = internal::hash::HugePageAllocator<T>;
+
+template <class T>
+using PoolAllocator = internal::hash::PoolAllocator<T>;
+
+using BlockPool = internal::hash::BlockPool;
+
+}  // namespace fgpl
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "internal/hash/atomic_hash_map.h"
+#include "reducer.h"
+
+namespace fgpl {
+// A lock-free map for integral keys and arithmetic values, such as counting with Reducer::sum
+// from many threads. Reserve the expected number of keys before the concurrent sets.
+template <class K, class V, class H = std::hash<K>>
+class AtomicHashMap : public internal::hash::AtomicHashMap<K, V, H> {
+ public:
+  void set(const K& key, const V& value) { set(key, value, Reducer<V>::overwrite); }
+
+  // Accepts any callable reducer, including std::function, which runs in a compare-and-swap loop.
+  template <class R>
+  void set(const K& key, const V& value, const R& reducer) {
+    internal::hash::AtomicHashMap<K, V, H>::set(key, hasher(key), value, reducer);
+  }
+
+  V get(const K& key, const V& default_value = V()) const {
+    return internal::hash::AtomicHashMap<K, V, H>::get(key, hasher(key), default_value);
+  }
+
+  bool has(const K& key) const {
+    return internal::hash::AtomicHashMap<K, V, H>::has(key, hasher(key));
+  }
+
+ private:
+  using internal::hash::AtomicHashMap<K, V, H>::hasher;
+
+  using internal::hash::AtomicHashMap<K, V, H>::set;
+
+  using internal::hash::AtomicHashMap<K, V, H>::get;
+
+  using internal::hash::AtomicHashMap<K, V, H>::has;
+};
+}  // namespace fgpl
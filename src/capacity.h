@@ -0,0 +1,11 @@
+#pragma once
+
+#include "internal/hash/capacity.h"
+
+namespace fgpl {
+
+using PrimeCapacity = internal::hash::PrimeCapacity;
+
+using PowerOfTwoCapacity = internal::hash::PowerOfTwoCapacity;
+
+}  // namespace fgpl
@@ -1,43 +1,124 @@
 #pragma once
 
+#include <vector>
+#include "frozen_hash_map.h"
 #include "internal/hash/concurrent_hash_map.h"
+#include "lock.h"
 #include "reducer.h"
 
 namespace fgpl {
 
-template <class K, class V, class H = std::hash<K>>
-class ConcurrentHashMap : public internal::hash::ConcurrentHashMap<K, V, H> {
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    template <class> class A = std::allocator,
+    class L = OmpLock>
+class ConcurrentHashMap : public internal::hash::ConcurrentHashMap<K, V, H, A, L> {
  public:
-  void set(
-      const K& key,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer = Reducer<V>::overwrite) {
-    internal::hash::ConcurrentHashMap<K, V, H>::set(key, hasher(key), value, reducer);
+  void set(const K& key, const V& value) { set(key, value, Reducer<V>::overwrite); }
+
+  // Accepts any callable reducer, including std::function.
+  template <class R>
+  void set(const K& key, const V& value, const R& reducer) {
+    internal::hash::ConcurrentHashMap<K, V, H, A, L>::set(key, hasher(key), value, reducer);
+  }
+
+  void async_set(const K& key, const V& value) { async_set(key, value, Reducer<V>::overwrite); }
+
+  template <class R>
+  void async_set(const K& key, const V& value, const R& reducer) {
+    internal::hash::ConcurrentHashMap<K, V, H, A, L>::async_set(key, hasher(key), value, reducer);
+  }
+
+  // Updates by a key of any type Q the hasher accepts in place of K, such as StringView with
+  // StringHasher. The key is only converted to K when inserted.
+  template <class Q, class R, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  void set(const Q& key, const V& value, const R& reducer) {
+    internal::hash::ConcurrentHashMap<K, V, H, A, L>::set(key, hasher(key), value, reducer);
+  }
+
+  template <class Q, class R, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  void async_set(const Q& key, const V& value, const R& reducer) {
+    internal::hash::ConcurrentHashMap<K, V, H, A, L>::async_set(key, hasher(key), value, reducer);
+  }
+
+  // Applies updater(V& value) in place under the segment lock, so that a read-modify-write takes
+  // one probe and one lock. A missing key is inserted with a value initialized value first.
+  template <class F>
+  bool update(const K& key, const F& updater) {
+    return internal::hash::ConcurrentHashMap<K, V, H, A, L>::update(key, hasher(key), updater);
+  }
+
+  template <class Q, class F, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  bool update(const Q& key, const F& updater) {
+    return internal::hash::ConcurrentHashMap<K, V, H, A, L>::update(key, hasher(key), updater);
+  }
+
+  // Safe to call concurrently with the writes. Reads of trivially copyable entries take no locks
+  // and retry when a write to the segment intervenes.
+  V get(const K& key, const V& default_value = V()) const {
+    return internal::hash::ConcurrentHashMap<K, V, H, A, L>::get(key, hasher(key), default_value);
+  }
+
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::get;
+
+  // Reads the value in place without copying it. Returns nullptr if not found. Takes no locks and
+  // the pointer dangles once the segment rehashes, so is only for phases without concurrent
+  // writes, such as after sync. Use get otherwise.
+  const V* find(const K& key) const {
+    return internal::hash::ConcurrentHashMap<K, V, H, A, L>::find(key, hasher(key));
   }
 
-  void async_set(
-      const K& key,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer = Reducer<V>::overwrite) {
-    internal::hash::ConcurrentHashMap<K, V, H>::async_set(key, hasher(key), value, reducer);
+  // Batched lookups that hash all the keys first and prefetch their buckets ahead of the probes.
+  // Safe to call concurrently with the writes, as get is.
+  // The keys are hashed a chunk at a time into a stack buffer.
+  void get_many(const K* keys, const size_t n, V* values, const V& default_value = V()) const {
+    internal::hash::for_each_hash_chunk(
+        hasher, keys, n, [&](const size_t begin, const size_t* hash_values, const size_t n_chunk) {
+          internal::hash::ConcurrentHashMap<K, V, H, A, L>::get_many(
+              keys + begin, hash_values, n_chunk, values + begin, default_value);
+        });
   }
 
-  void unset(const K& key) { internal::hash::ConcurrentHashMap<K, V, H>::unset(key, hasher(key)); }
+  void has_many(const K* keys, const size_t n, bool* res) const {
+    internal::hash::for_each_hash_chunk(
+        hasher, keys, n, [&](const size_t begin, const size_t* hash_values, const size_t n_chunk) {
+          internal::hash::ConcurrentHashMap<K, V, H, A, L>::has_many(
+              keys + begin, hash_values, n_chunk, res + begin);
+        });
+  }
+
+  void unset(const K& key) {
+    internal::hash::ConcurrentHashMap<K, V, H, A, L>::unset(key, hasher(key));
+  }
 
   bool has(const K& key) {
-    return internal::hash::ConcurrentHashMap<K, V, H>::has(key, hasher(key));
+    return internal::hash::ConcurrentHashMap<K, V, H, A, L>::has(key, hasher(key));
+  }
+
+  FrozenHashMap<K, V, H> freeze() const {
+    return internal::hash::ConcurrentHashMap<K, V, H, A, L>::freeze();
   }
 
  private:
   H hasher;
 
-  using internal::hash::ConcurrentHashMap<K, V, H>::set;
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::set;
+
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::async_set;
+
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::update;
+
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::find;
+
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::unset;
 
-  using internal::hash::ConcurrentHashMap<K, V, H>::async_set;
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::has;
 
-  using internal::hash::ConcurrentHashMap<K, V, H>::unset;
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::get_many;
 
-  using internal::hash::ConcurrentHashMap<K, V, H>::has;
+  using internal::hash::ConcurrentHashMap<K, V, H, A, L>::has_many;
 };
 
 }  // namespace fgpl
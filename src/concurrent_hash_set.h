@@ -1,32 +1,41 @@
 #pragma once
 
 #include "internal/hash/concurrent_hash_set.h"
+#include "lock.h"
 
 namespace fgpl {
 
-template <class K, class H = std::hash<K>>
-class ConcurrentHashSet : public internal::hash::ConcurrentHashSet<K, H> {
+template <
+    class K,
+    class H = std::hash<K>,
+    template <class> class A = std::allocator,
+    class L = OmpLock>
+class ConcurrentHashSet : public internal::hash::ConcurrentHashSet<K, H, A, L> {
  public:
-  void set(const K& key) { internal::hash::ConcurrentHashSet<K, H>::set(key, hasher(key)); }
+  void set(const K& key) { internal::hash::ConcurrentHashSet<K, H, A, L>::set(key, hasher(key)); }
 
   void async_set(const K& key) {
-    internal::hash::ConcurrentHashSet<K, H>::async_set(key, hasher(key));
+    internal::hash::ConcurrentHashSet<K, H, A, L>::async_set(key, hasher(key));
   }
 
-  void unset(const K& key) { internal::hash::ConcurrentHashSet<K, H>::unset(key, hasher(key)); }
+  void unset(const K& key) {
+    internal::hash::ConcurrentHashSet<K, H, A, L>::unset(key, hasher(key));
+  }
 
-  bool has(const K& key) { return internal::hash::ConcurrentHashSet<K, H>::has(key, hasher(key)); }
+  bool has(const K& key) {
+    return internal::hash::ConcurrentHashSet<K, H, A, L>::has(key, hasher(key));
+  }
 
  private:
   H hasher;
 
-  using internal::hash::ConcurrentHashSet<K, H>::set;
+  using internal::hash::ConcurrentHashSet<K, H, A, L>::set;
 
-  using internal::hash::ConcurrentHashSet<K, H>::async_set;
+  using internal::hash::ConcurrentHashSet<K, H, A, L>::async_set;
 
-  using internal::hash::ConcurrentHashSet<K, H>::unset;
+  using internal::hash::ConcurrentHashSet<K, H, A, L>::unset;
 
-  using internal::hash::ConcurrentHashSet<K, H>::has;
+  using internal::hash::ConcurrentHashSet<K, H, A, L>::has;
 };
 
 }  // namespace fgpl
@@ -1,26 +1,28 @@
 #pragma once
 
 #include <omp.h>
+#include <cstddef>
 #include <functional>
 #include <numeric>
 #include <vector>
+#include "lock.h"
 #include "reducer.h"
 
 namespace fgpl {
 
-template <class T>
+// The segment locks are of the lock policy L, see lock.h.
+template <class T, class L = OmpLock>
 class ConcurrentVector {
  public:
   ConcurrentVector();
 
-  ~ConcurrentVector();
-
   void resize(const size_t n, const T& value = T());
 
-  void set(
-      const size_t i,
-      const T& value,
-      const std::function<void(T&, const T&)>& reducer = Reducer<T>::overwrite);
+  void set(const size_t i, const T& value) { set(i, value, Reducer<T>::overwrite); }
+
+  // Accepts any callable reducer, including std::function.
+  template <class R>
+  void set(const size_t i, const T& value, const R& reducer);
 
   void for_each_serial(const std::function<void(const size_t i, const T& value)>& handler) const;
 
@@ -31,56 +33,54 @@ class ConcurrentVector {
 
   size_t n_segments_shift;
 
-  std::vector<std::vector<T>> segments;
+  // The lock and the elements header of a segment, on a cache line of their own.
+  struct alignas(internal::CACHE_LINE_SIZE) Segment {
+    L lock;
+
+    std::vector<T> elems;
+  };
 
-  std::vector<omp_lock_t> segment_locks;
+  internal::CacheLineArray<Segment> segments;
 };
 
-template <class T>
-ConcurrentVector<T>::ConcurrentVector() {
+template <class T, class L>
+ConcurrentVector<T, L>::ConcurrentVector() {
   const size_t n_threads = omp_get_max_threads();
   n_segments = 4;
   while (n_segments < n_threads) n_segments <<= 1;
   n_segments <<= 2;
   n_segments_shift = __builtin_ctzll(n_segments);
-  segments.resize(n_segments);
-  segment_locks.resize(n_segments);
-  for (auto& lock : segment_locks) omp_init_lock(&lock);
-}
-
-template <class T>
-ConcurrentVector<T>::~ConcurrentVector() {
-  for (auto& lock : segment_locks) omp_destroy_lock(&lock);
+  segments.reset(n_segments);
 }
 
-template <class T>
-void ConcurrentVector<T>::resize(const size_t n, const T& value) {
+template <class T, class L>
+void ConcurrentVector<T, L>::resize(const size_t n, const T& value) {
   this->n = n;
   const size_t segment_size = (n >> n_segments_shift) + 1;
   for (size_t segment_id = 0; segment_id < n_segments; segment_id++) {
-    segments[segment_id].resize(segment_size, value);
+    segments[segment_id].elems.resize(segment_size, value);
   }
 }
 
-template <class T>
-void ConcurrentVector<T>::set(
-    const size_t i, const T& value, const std::function<void(T&, const T&)>& reducer) {
+template <class T, class L>
+template <class R>
+void ConcurrentVector<T, L>::set(const size_t i, const T& value, const R& reducer) {
   const size_t segment_id = i & (n_segments - 1);
   const size_t elem_id = i >> n_segments_shift;
-  auto& lock = segment_locks[segment_id];
-  omp_set_lock(&lock);
-  reducer(segments[segment_id][elem_id], value);
-  omp_unset_lock(&lock);
+  Segment& segment = segments[segment_id];
+  segment.lock.lock();
+  reducer(segment.elems[elem_id], value);
+  segment.lock.unlock();
 }
 
-template <class T>
-void ConcurrentVector<T>::for_each_serial(
+template <class T, class L>
+void ConcurrentVector<T, L>::for_each_serial(
     const std::function<void(const size_t i, const T& value)>& handler) const {
   size_t i = 0;
   size_t segment_id = 0;
   size_t elem_id = 0;
   while (i < n) {
-    handler(i, segments[segment_id][elem_id]); 
+    handler(i, segments[segment_id].elems[elem_id]); 
     i++;
     segment_id++;
     if (segment_id == n_segments) {
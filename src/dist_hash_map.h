@@ -1,28 +1,42 @@
 #pragma once
 
+#include "frozen_hash_map.h"
 #include "internal/hash/dist_hash_map.h"
 #include "reducer.h"
 
 namespace fgpl {
-template <class K, class V, class H = std::hash<K>>
-class DistHashMap : public internal::hash::DistHashMap<K, V, H> {
+template <class K, class V, class H = std::hash<K>, template <class> class A = std::allocator>
+class DistHashMap : public internal::hash::DistHashMap<K, V, H, A> {
  public:
-  void async_set(
-      const K& key,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer = Reducer<V>::overwrite) {
-    internal::hash::DistHashMap<K, V, H>::async_set(key, hasher(key), value, reducer);
+  void async_set(const K& key, const V& value) { async_set(key, value, Reducer<V>::overwrite); }
+
+  // Accepts any callable reducer, including std::function.
+  template <class R>
+  void async_set(const K& key, const V& value, const R& reducer) {
+    internal::hash::DistHashMap<K, V, H, A>::async_set(key, hasher(key), value, reducer);
+  }
+
+  // Updates by a key of any type Q the hasher accepts in place of K, such as StringView with
+  // StringHasher. The key is only converted to K when inserted.
+  template <class Q, class R, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  void async_set(const Q& key, const V& value, const R& reducer) {
+    internal::hash::DistHashMap<K, V, H, A>::async_set(key, hasher(key), value, reducer);
+  }
+
+  V get_local(const K& key, const V& default_value) const {
+    return internal::hash::DistHashMap<K, V, H, A>::get_local(key, hasher(key), default_value);
   }
 
-  double get_local(const K& key, const V& default_value) const {
-    return internal::hash::DistHashMap<K, V, H>::get_local(key, hasher(key), default_value);
+  // Lookups into it only find the keys of this proc, like get_local.
+  FrozenHashMap<K, V, internal::hash::DistHasher<K, H>> freeze_local() const {
+    return internal::hash::DistHashMap<K, V, H, A>::freeze_local();
   }
 
  private:
   H hasher;
 
-  using internal::hash::DistHashMap<K, V, H>::async_set;
+  using internal::hash::DistHashMap<K, V, H, A>::async_set;
 
-  using internal::hash::DistHashMap<K, V, H>::get_local;
+  using internal::hash::DistHashMap<K, V, H, A>::get_local;
 };
 }  // namespace fgpl
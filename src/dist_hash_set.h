@@ -4,14 +4,16 @@
 #include "reducer.h"
 
 namespace fgpl {
-template <class K, class H = std::hash<K>>
-class DistHashSet : public internal::hash::DistHashSet<K, H> {
+template <class K, class H = std::hash<K>, template <class> class A = std::allocator>
+class DistHashSet : public internal::hash::DistHashSet<K, H, A> {
  public:
-  void async_set(const K& key) { internal::hash::DistHashSet<K, H>::async_set(key, hasher(key)); }
+  void async_set(const K& key) {
+    internal::hash::DistHashSet<K, H, A>::async_set(key, hasher(key));
+  }
 
  private:
   H hasher;
 
-  using internal::hash::DistHashSet<K, H>::async_set;
+  using internal::hash::DistHashSet<K, H, A>::async_set;
 };
 }  // namespace fgpl
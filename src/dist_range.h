@@ -41,11 +41,11 @@ class DistRange {
     }
   }
 
-  template <class K, class V, class H>
+  template <class K, class V, class H, class R>
   void mapreduce(
       const std::function<void(const T value, const std::function<void(const K&, const V&)>& emit)>&
           mapper,
-      const std::function<void(V&, const V&)>& reducer,
+      const R& reducer,
       DistHashMap<K, V, H>& dm) {
     const auto& emit = [&](const K& key, const V& value) {
       dm.async_set(key, value, reducer);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <utility>
+#include "internal/hash/frozen_hash_map.h"
+
+namespace fgpl {
+// The immutable table returned by the freeze of HashMap and ConcurrentHashMap, for the phases
+// that only read after building. Lookups take no locks and may run on any number of threads.
+template <class K, class V, class H = std::hash<K>>
+class FrozenHashMap : public internal::hash::FrozenHashMap<K, V, H> {
+ public:
+  FrozenHashMap() = default;
+
+  FrozenHashMap(internal::hash::FrozenHashMap<K, V, H>&& m)
+      : internal::hash::FrozenHashMap<K, V, H>(std::move(m)) {}
+
+  V get(const K& key, const V& default_value = V()) const {
+    return internal::hash::FrozenHashMap<K, V, H>::get(key, hasher(key), default_value);
+  }
+
+  bool has(const K& key) const {
+    return internal::hash::FrozenHashMap<K, V, H>::has(key, hasher(key));
+  }
+
+  const V* find(const K& key) const {
+    return internal::hash::FrozenHashMap<K, V, H>::find(key, hasher(key));
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  V get(const Q& key, const V& default_value = V()) const {
+    return internal::hash::FrozenHashMap<K, V, H>::get(key, hasher(key), default_value);
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  bool has(const Q& key) const {
+    return internal::hash::FrozenHashMap<K, V, H>::has(key, hasher(key));
+  }
+
+ private:
+  using internal::hash::FrozenHashMap<K, V, H>::hasher;
+
+  using internal::hash::FrozenHashMap<K, V, H>::get;
+
+  using internal::hash::FrozenHashMap<K, V, H>::has;
+
+  using internal::hash::FrozenHashMap<K, V, H>::find;
+};
+}  // namespace fgpl
@@ -1,36 +1,176 @@
 #pragma once
 
+#include <vector>
+#include "capacity.h"
+#include "frozen_hash_map.h"
 #include "internal/hash/hash_map.h"
+#include "probing.h"
 #include "reducer.h"
 
 namespace fgpl {
-template <class K, class V, class H = std::hash<K>>
-class HashMap : public internal::hash::HashMap<K, V, H> {
+using HashStats = internal::hash::HashStats;
+
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing,
+    template <class> class A = std::allocator>
+class HashMap : public internal::hash::HashMap<K, V, H, C, P, A> {
  public:
-  void set(
-      const K& key,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer = Reducer<V>::overwrite) {
-    internal::hash::HashMap<K, V, H>::set(key, hasher(key), value, reducer);
+  void set(const K& key, const V& value) { set(key, value, Reducer<V>::overwrite); }
+
+  void set(K&& key, V&& value) { set(std::move(key), std::move(value), Reducer<V>::overwrite); }
+
+  // Accepts any callable reducer, including std::function.
+  template <class R>
+  void set(const K& key, const V& value, const R& reducer) {
+    internal::hash::HashMap<K, V, H, C, P, A>::set(key, hasher(key), value, reducer);
+  }
+
+  template <class R>
+  void set(K&& key, V&& value, const R& reducer) {
+    const size_t hash_value = hasher(key);
+    internal::hash::HashMap<K, V, H, C, P, A>::set(
+        std::move(key), hash_value, std::move(value), reducer);
+  }
+
+  template <class... Args>
+  void emplace(const K& key, Args&&... args) {
+    internal::hash::HashMap<K, V, H, C, P, A>::emplace(
+        key, hasher(key), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void emplace(K&& key, Args&&... args) {
+    const size_t hash_value = hasher(key);
+    internal::hash::HashMap<K, V, H, C, P, A>::emplace(
+        std::move(key), hash_value, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  bool try_emplace(const K& key, Args&&... args) {
+    return internal::hash::HashMap<K, V, H, C, P, A>::try_emplace(
+        key, hasher(key), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  bool try_emplace(K&& key, Args&&... args) {
+    const size_t hash_value = hasher(key);
+    return internal::hash::HashMap<K, V, H, C, P, A>::try_emplace(
+        std::move(key), hash_value, std::forward<Args>(args)...);
+  }
+
+  template <class F, class G>
+  bool upsert(const K& key, const F& updater, const G& creator) {
+    return internal::hash::HashMap<K, V, H, C, P, A>::upsert(key, hasher(key), updater, creator);
   }
 
   V get(const K& key, const V& default_value = V()) const {
-    return internal::hash::HashMap<K, V, H>::get(key, hasher(key), default_value);
+    return internal::hash::HashMap<K, V, H, C, P, A>::get(key, hasher(key), default_value);
+  }
+
+  // Reads the value in place without copying it. Returns nullptr if not found.
+  const V* find(const K& key) const {
+    return internal::hash::HashMap<K, V, H, C, P, A>::find(key, hasher(key));
+  }
+
+  V* find(const K& key) {
+    return internal::hash::HashMap<K, V, H, C, P, A>::find(key, hasher(key));
+  }
+
+  V& get_or_insert(const K& key, const V& default_value = V()) {
+    return internal::hash::HashMap<K, V, H, C, P, A>::get_or_insert(
+        key, hasher(key), default_value);
   }
 
-  void unset(const K& key) { internal::hash::HashMap<K, V, H>::unset(key, hasher(key)); }
+  // Batched lookups that hash all the keys first and prefetch their buckets ahead of the probes.
+  // The keys are hashed a chunk at a time into a stack buffer.
+  void get_many(const K* keys, const size_t n, V* values, const V& default_value = V()) const {
+    internal::hash::for_each_hash_chunk(
+        hasher, keys, n, [&](const size_t begin, const size_t* hash_values, const size_t n_chunk) {
+          internal::hash::HashMap<K, V, H, C, P, A>::get_many(
+              keys + begin, hash_values, n_chunk, values + begin, default_value);
+        });
+  }
 
-  bool has(const K& key) const { return internal::hash::HashMap<K, V, H>::has(key, hasher(key)); }
+  void has_many(const K* keys, const size_t n, bool* res) const {
+    internal::hash::for_each_hash_chunk(
+        hasher, keys, n, [&](const size_t begin, const size_t* hash_values, const size_t n_chunk) {
+          internal::hash::HashMap<K, V, H, C, P, A>::has_many(
+              keys + begin, hash_values, n_chunk, res + begin);
+        });
+  }
+
+  // Lookups and updates by a key of any type Q the hasher accepts in place of K, such as
+  // StringView with StringHasher. The key is only converted to K when inserted.
+  // The value is taken by forwarding reference so that these win over the rvalue set overloads.
+  template <class Q, class VV, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  void set(const Q& key, VV&& value) {
+    set(key, std::forward<VV>(value), Reducer<V>::overwrite);
+  }
+
+  template <class Q, class VV, class R, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  void set(const Q& key, VV&& value, const R& reducer) {
+    internal::hash::HashMap<K, V, H, C, P, A>::set(key, hasher(key), value, reducer);
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  V get(const Q& key, const V& default_value = V()) const {
+    return internal::hash::HashMap<K, V, H, C, P, A>::get(key, hasher(key), default_value);
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  bool has(const Q& key) const {
+    return internal::hash::HashMap<K, V, H, C, P, A>::has(key, hasher(key));
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  const V* find(const Q& key) const {
+    return internal::hash::HashMap<K, V, H, C, P, A>::find(key, hasher(key));
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  V* find(const Q& key) {
+    return internal::hash::HashMap<K, V, H, C, P, A>::find(key, hasher(key));
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  V& get_or_insert(const Q& key, const V& default_value = V()) {
+    return internal::hash::HashMap<K, V, H, C, P, A>::get_or_insert(
+        key, hasher(key), default_value);
+  }
+
+  void unset(const K& key) { internal::hash::HashMap<K, V, H, C, P, A>::unset(key, hasher(key)); }
+
+  bool has(const K& key) const {
+    return internal::hash::HashMap<K, V, H, C, P, A>::has(key, hasher(key));
+  }
+
+  FrozenHashMap<K, V, H> freeze() const {
+    return internal::hash::HashMap<K, V, H, C, P, A>::freeze();
+  }
 
  private:
-  H hasher;
+  using internal::hash::HashMap<K, V, H, C, P, A>::hasher;
+
+  using internal::hash::HashMap<K, V, H, C, P, A>::set;
+
+  using internal::hash::HashMap<K, V, H, C, P, A>::upsert;
+
+  using internal::hash::HashMap<K, V, H, C, P, A>::get;
+
+  using internal::hash::HashMap<K, V, H, C, P, A>::find;
+
+  using internal::hash::HashMap<K, V, H, C, P, A>::get_or_insert;
 
-  using internal::hash::HashMap<K, V, H>::set;
+  using internal::hash::HashMap<K, V, H, C, P, A>::unset;
 
-  using internal::hash::HashMap<K, V, H>::get;
+  using internal::hash::HashMap<K, V, H, C, P, A>::has;
 
-  using internal::hash::HashMap<K, V, H>::unset;
+  using internal::hash::HashMap<K, V, H, C, P, A>::get_many;
 
-  using internal::hash::HashMap<K, V, H>::has;
+  using internal::hash::HashMap<K, V, H, C, P, A>::has_many;
 };
 }  // namespace fgpl
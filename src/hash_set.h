@@ -1,25 +1,66 @@
 #pragma once
 
+#include <vector>
+#include "capacity.h"
 #include "internal/hash/hash_set.h"
+#include "probing.h"
 #include "reducer.h"
 
 namespace fgpl {
-template <class K, class H = std::hash<K>>
-class HashSet : public internal::hash::HashSet<K, H> {
+using HashStats = internal::hash::HashStats;
+
+template <
+    class K,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing,
+    template <class> class A = std::allocator>
+class HashSet : public internal::hash::HashSet<K, H, C, P, A> {
  public:
-  void set(const K& key) { internal::hash::HashSet<K, H>::set(key, hasher(key)); }
+  void set(const K& key) { internal::hash::HashSet<K, H, C, P, A>::set(key, hasher(key)); }
+
+  void set(K&& key) {
+    const size_t hash_value = hasher(key);
+    internal::hash::HashSet<K, H, C, P, A>::set(std::move(key), hash_value);
+  }
+
+  // Lookups and insertions by a key of any type Q the hasher accepts in place of K, such as
+  // StringView with StringHasher. The key is only converted to K when inserted.
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  void set(const Q& key) {
+    internal::hash::HashSet<K, H, C, P, A>::insert(key, hasher(key));
+  }
 
-  void unset(const K& key) { internal::hash::HashSet<K, H>::unset(key, hasher(key)); }
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  bool has(const Q& key) const {
+    return internal::hash::HashSet<K, H, C, P, A>::has(key, hasher(key));
+  }
 
-  bool has(const K& key) const { return internal::hash::HashSet<K, H>::has(key, hasher(key)); }
+  void unset(const K& key) { internal::hash::HashSet<K, H, C, P, A>::unset(key, hasher(key)); }
+
+  bool has(const K& key) const {
+    return internal::hash::HashSet<K, H, C, P, A>::has(key, hasher(key));
+  }
+
+  // Batched lookups that hash all the keys first and prefetch their buckets ahead of the probes.
+  // The keys are hashed a chunk at a time into a stack buffer.
+  void has_many(const K* keys, const size_t n, bool* res) const {
+    internal::hash::for_each_hash_chunk(
+        hasher, keys, n, [&](const size_t begin, const size_t* hash_values, const size_t n_chunk) {
+          internal::hash::HashSet<K, H, C, P, A>::has_many(
+              keys + begin, hash_values, n_chunk, res + begin);
+        });
+  }
 
  private:
-  H hasher;
+  using internal::hash::HashSet<K, H, C, P, A>::hasher;
+
+  using internal::hash::HashSet<K, H, C, P, A>::set;
 
-  using internal::hash::HashSet<K, H>::set;
+  using internal::hash::HashSet<K, H, C, P, A>::unset;
 
-  using internal::hash::HashSet<K, H>::unset;
+  using internal::hash::HashSet<K, H, C, P, A>::has;
 
-  using internal::hash::HashSet<K, H>::has;
+  using internal::hash::HashSet<K, H, C, P, A>::has_many;
 };
 }  // namespace fgpl
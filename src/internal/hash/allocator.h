@@ -0,0 +1,265 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// Allocations from HUGE_PAGE_SIZE up are mapped directly, preferring the reserved huge pages of
+// HUGE_PAGE_SIZE, whatever the default huge page size, and otherwise asking for transparent huge
+// pages, which cuts the TLB misses of large tables.
+// Elements are default initialized rather than value initialized, so that the pages of trivial
+// buckets are only touched, and zeroed by the kernel, when first written.
+template <class T>
+class HugePageAllocator {
+ public:
+  using value_type = T;
+
+  constexpr static int HUGE_PAGE_SHIFT = 21;
+
+  constexpr static size_t HUGE_PAGE_SIZE = size_t(1) << HUGE_PAGE_SHIFT;
+
+  HugePageAllocator() = default;
+
+  template <class U>
+  HugePageAllocator(const HugePageAllocator<U>&) {}
+
+  T* allocate(const size_t n);
+
+  void deallocate(T* ptr, const size_t n);
+
+  template <class U>
+  void construct(U* ptr) {
+    ::new (static_cast<void*>(ptr)) U;
+  }
+
+  template <class U, class... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+ private:
+  static size_t get_n_mapped_bytes(const size_t n_bytes) {
+    return (n_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  }
+};
+
+// Blocks released by PoolAllocator, kept by size class for the next allocations of the class,
+// which skips the page faults of fresh memory when tables are cleared and regrown. The classes
+// are 4 to 7 times powers of two, so blocks are at most a quarter larger than asked for. Blocks
+// released beyond the max pooled bytes are freed instead.
+class BlockPool {
+ public:
+  // Never destroyed, so that the tables destroyed at exit can still release their blocks.
+  static BlockPool& get_instance() {
+    static BlockPool* instance = new BlockPool();
+    return *instance;
+  }
+
+  BlockPool(const BlockPool&) = delete;
+
+  BlockPool& operator=(const BlockPool&) = delete;
+
+  void* acquire(const size_t n_bytes);
+
+  void release(void* ptr, const size_t n_bytes);
+
+  // Frees all the pooled blocks.
+  void release_all();
+
+  // Frees the pooled blocks, the largest first, until at most n_bytes remain pooled.
+  void trim(const size_t n_bytes);
+
+  size_t get_n_pooled_bytes() const { return n_pooled_bytes.load(std::memory_order_relaxed); }
+
+  // Trims to max_pooled_bytes if above.
+  void set_max_pooled_bytes(const size_t max_pooled_bytes);
+
+  size_t get_max_pooled_bytes() const {
+    return max_pooled_bytes.load(std::memory_order_relaxed);
+  }
+
+  constexpr static size_t DEFAULT_MAX_POOLED_BYTES = size_t(1) << 30;
+
+ private:
+  BlockPool() : n_pooled_bytes(0), max_pooled_bytes(DEFAULT_MAX_POOLED_BYTES) {}
+
+  std::mutex mutex;
+
+  // By size class.
+  std::map<size_t, std::vector<void*>> blocks;
+
+  // Updated under the mutex.
+  std::atomic<size_t> n_pooled_bytes;
+
+  std::atomic<size_t> max_pooled_bytes;
+
+  static size_t get_size_class(const size_t n_bytes);
+
+  // Requires the mutex.
+  void trim_locked(const size_t n_bytes);
+};
+
+// Recycles the memory of deallocated arrays through the BlockPool shared by all the threads.
+// Like HugePageAllocator, elements are default initialized.
+template <class T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+
+  template <class U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(const size_t n) {
+    return static_cast<T*>(BlockPool::get_instance().acquire(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, const size_t n) {
+    BlockPool::get_instance().release(ptr, n * sizeof(T));
+  }
+
+  template <class U>
+  void construct(U* ptr) {
+    ::new (static_cast<void*>(ptr)) U;
+  }
+
+  template <class U, class... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+};
+
+template <class T, class U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) {
+  return false;
+}
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+template <class T>
+T* HugePageAllocator<T>::allocate(const size_t n) {
+  const size_t n_bytes = n * sizeof(T);
+  if (n_bytes < HUGE_PAGE_SIZE) return static_cast<T*>(::operator new(n_bytes));
+  const size_t n_mapped_bytes = get_n_mapped_bytes(n_bytes);
+  void* ptr = MAP_FAILED;
+  // Without the page size flag, MAP_HUGETLB takes the default huge pages, of which munmap would
+  // need the size, e.g. 1GB ones.
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  ptr = mmap(
+      nullptr,
+      n_mapped_bytes,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (HUGE_PAGE_SHIFT << MAP_HUGE_SHIFT),
+      -1,
+      0);
+#endif
+  if (ptr == MAP_FAILED) {
+    ptr = mmap(nullptr, n_mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, n_mapped_bytes, MADV_HUGEPAGE);
+#endif
+  }
+  return static_cast<T*>(ptr);
+}
+
+template <class T>
+void HugePageAllocator<T>::deallocate(T* ptr, const size_t n) {
+  const size_t n_bytes = n * sizeof(T);
+  if (n_bytes < HUGE_PAGE_SIZE) {
+    ::operator delete(ptr);
+  } else {
+    munmap(ptr, get_n_mapped_bytes(n_bytes));
+  }
+}
+
+inline void* BlockPool::acquire(const size_t n_bytes) {
+  const size_t size_class = get_size_class(n_bytes);
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto it = blocks.find(size_class);
+    if (it != blocks.end() && !it->second.empty()) {
+      void* ptr = it->second.back();
+      it->second.pop_back();
+      n_pooled_bytes.store(n_pooled_bytes.load() - size_class, std::memory_order_relaxed);
+      return ptr;
+    }
+  }
+  return ::operator new(size_class);
+}
+
+inline void BlockPool::release(void* ptr, const size_t n_bytes) {
+  const size_t size_class = get_size_class(n_bytes);
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (n_pooled_bytes.load() + size_class <= max_pooled_bytes.load()) {
+      blocks[size_class].push_back(ptr);
+      n_pooled_bytes.store(n_pooled_bytes.load() + size_class, std::memory_order_relaxed);
+      return;
+    }
+  }
+  ::operator delete(ptr);
+}
+
+inline void BlockPool::release_all() { trim(0); }
+
+inline void BlockPool::trim(const size_t n_bytes) {
+  std::lock_guard<std::mutex> guard(mutex);
+  trim_locked(n_bytes);
+}
+
+inline void BlockPool::set_max_pooled_bytes(const size_t max_pooled_bytes) {
+  std::lock_guard<std::mutex> guard(mutex);
+  this->max_pooled_bytes.store(max_pooled_bytes, std::memory_order_relaxed);
+  trim_locked(max_pooled_bytes);
+}
+
+inline size_t BlockPool::get_size_class(const size_t n_bytes) {
+  if (n_bytes <= 4) return 4;
+  size_t unit = 1;
+  while ((n_bytes - 1) / unit >= 8) unit <<= 1;
+  return ((n_bytes - 1) / unit + 1) * unit;
+}
+
+inline void BlockPool::trim_locked(const size_t n_bytes) {
+  size_t n_remaining_bytes = n_pooled_bytes.load();
+  while (n_remaining_bytes > n_bytes && !blocks.empty()) {
+    const auto it = std::prev(blocks.end());
+    const size_t size_class = it->first;
+    while (n_remaining_bytes > n_bytes && !it->second.empty()) {
+      ::operator delete(it->second.back());
+      it->second.pop_back();
+      n_remaining_bytes -= size_class;
+    }
+    if (it->second.empty()) blocks.erase(it);
+  }
+  n_pooled_bytes.store(n_remaining_bytes, std::memory_order_relaxed);
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
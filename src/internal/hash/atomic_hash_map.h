@@ -0,0 +1,469 @@
+#pragma once
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "../../reducer.h"
+#include "../lock.h"
+#include "capacity.h"
+#include "concurrent_hash_map.h"
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// A linear probing map whose slots are claimed with compare-and-swap on the key and whose values
+// are reduced with atomic operations, so that concurrent sets take no locks. Sums of integral
+// values use fetch_add, overwrites a store, and the other reducers a compare-and-swap loop.
+// The table only grows in reserve, which must not run concurrently with the other calls. Beyond
+// max_load_factor, the new keys go to an overflow ConcurrentHashMap until the next reserve, and
+// is_full turns true. So do the keys whose probes find no room, and the two largest keys, which
+// mark the empty and busy slots.
+template <class K, class V, class H = std::hash<K>>
+class AtomicHashMap {
+ public:
+  static_assert(std::is_integral<K>::value, "AtomicHashMap requires integral keys.");
+
+  static_assert(std::is_arithmetic<V>::value, "AtomicHashMap requires arithmetic values.");
+
+  constexpr static float DEFAULT_MAX_LOAD_FACTOR = 0.7;
+
+  constexpr static size_t MAX_N_PROBES = 128;
+
+  // Applies from the next reserve or clear.
+  float max_load_factor;
+
+  AtomicHashMap();
+
+  AtomicHashMap(const AtomicHashMap& m);
+
+  // Rehashes into a table for at least n_keys_min keys, which also moves in the overflow keys.
+  void reserve(const size_t n_keys_min);
+
+  size_t get_n_keys() const;
+
+  size_t get_n_buckets() const { return n_buckets; }
+
+  // Number of keys in the overflow map, a sign that the table needs a larger reserve.
+  size_t get_n_overflow_keys() const { return overflow.get_n_keys(); }
+
+  // Whether new keys went to the overflow map for the table reaching max_load_factor.
+  bool is_full() const { return full.load(std::memory_order_relaxed); }
+
+  template <class R>
+  void set(const K& key, const size_t hash_value, const V& value, const R& reducer);
+
+  // Safe during concurrent sets. The overflow keys are looked up through ConcurrentHashMap::get
+  // and has, which retry or lock when a write to the segment intervenes.
+  V get(const K& key, const size_t hash_value, const V& default_value) const;
+
+  bool has(const K& key, const size_t hash_value) const;
+
+  // Visits the slots with all the threads, then the overflow keys.
+  template <class F>
+  void for_each(const F& handler) const;
+
+  template <class F>
+  void for_each_serial(const F& handler) const;
+
+  void clear();
+
+ protected:
+  struct Slot {
+    std::atomic<K> key;
+
+    std::atomic<V> value;
+  };
+
+  // The keys of different threads and the free slots handed to them, on different cache lines.
+  struct alignas(CACHE_LINE_SIZE) KeyCounter {
+    std::atomic<size_t> n_keys;
+
+    std::atomic<size_t> n_free_slots;
+
+    KeyCounter() : n_keys(0), n_free_slots(0) {}
+  };
+
+  size_t n_buckets;
+
+  std::unique_ptr<Slot[]> slots;
+
+  PowerOfTwoCapacity capacity;
+
+  ConcurrentHashMap<K, V, H> overflow;
+
+  size_t n_counters;
+
+  CacheLineArray<KeyCounter> counters;
+
+  // The slots below max_load_factor not yet handed to the counters.
+  std::atomic<size_t> n_free_slots;
+
+  std::atomic<bool> full;
+
+  H hasher;
+
+ private:
+  constexpr static K EMPTY_KEY = std::numeric_limits<K>::max();
+
+  constexpr static K BUSY_KEY = std::numeric_limits<K>::max() - 1;
+
+  // The free slots a counter takes at once, so that the shared count is rarely touched.
+  constexpr static size_t N_FREE_SLOTS_BATCH = 64;
+
+  void init_slots(const size_t n_buckets);
+
+  // Sets n_free_slots from max_load_factor for the table holding n_keys keys.
+  void init_free_slots(const size_t n_keys);
+
+  KeyCounter& get_counter() { return counters[ThreadIndex::get() % n_counters]; }
+
+  // Takes a free slot for a new key, or returns false when the table reached max_load_factor.
+  bool acquire_free_slot(KeyCounter& counter);
+
+  static bool take_free_slot(KeyCounter& counter);
+
+  // Sets the key found full at the empty slot bucket_id, either in a later slot already holding
+  // it or in the overflow map.
+  template <class R>
+  void set_when_full(
+      const K& key,
+      const size_t hash_value,
+      const V& value,
+      const R& reducer,
+      size_t bucket_id,
+      size_t n_probes);
+
+  size_t next_bucket_id(const size_t bucket_id) const {
+    return bucket_id + 1 == n_buckets ? 0 : bucket_id + 1;
+  }
+
+  // Returns the key of the slot once the thread claiming it has published it, or EMPTY_KEY if the
+  // thread gave the slot up.
+  static K load_key(const Slot& slot);
+
+  template <class R>
+  static void reduce(std::atomic<V>& slot_value, const V& value, const R& reducer);
+
+  static void reduce(std::atomic<V>& slot_value, const V& value, const typename Reducer<V>::Sum&);
+
+  static void reduce(
+      std::atomic<V>& slot_value, const V& value, const typename Reducer<V>::Overwrite&) {
+    slot_value.store(value, std::memory_order_relaxed);
+  }
+
+  static void reduce(std::atomic<V>&, const V&, const typename Reducer<V>::Keep&) {}
+
+  static void fetch_add(std::atomic<V>& slot_value, const V& value, std::true_type) {
+    slot_value.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  static void fetch_add(std::atomic<V>& slot_value, const V& value, std::false_type) {
+    reduce(slot_value, value, [](V& v1, const V& v2) { v1 += v2; });
+  }
+};
+
+template <class K, class V, class H>
+constexpr K AtomicHashMap<K, V, H>::EMPTY_KEY;
+
+template <class K, class V, class H>
+constexpr K AtomicHashMap<K, V, H>::BUSY_KEY;
+
+template <class K, class V, class H>
+AtomicHashMap<K, V, H>::AtomicHashMap() {
+  max_load_factor = DEFAULT_MAX_LOAD_FACTOR;
+  n_counters = omp_get_max_threads();
+  counters.reset(n_counters);
+  init_slots(PowerOfTwoCapacity::N_INITIAL_BUCKETS);
+  init_free_slots(0);
+}
+
+template <class K, class V, class H>
+AtomicHashMap<K, V, H>::AtomicHashMap(const AtomicHashMap& m) : overflow(m.overflow) {
+  max_load_factor = m.max_load_factor;
+  n_counters = m.n_counters;
+  counters.reset(n_counters);
+  init_slots(m.n_buckets);
+  for (size_t i = 0; i < n_buckets; i++) {
+    slots[i].key.store(load_key(m.slots[i]), std::memory_order_relaxed);
+    slots[i].value.store(m.slots[i].value.load(), std::memory_order_relaxed);
+  }
+  size_t n_keys = 0;
+  for (size_t i = 0; i < n_counters; i++) {
+    counters[i].n_keys.store(m.counters[i].n_keys.load());
+    n_keys += counters[i].n_keys.load();
+  }
+  init_free_slots(n_keys);
+  full.store(m.full.load());
+}
+
+template <class K, class V, class H>
+void AtomicHashMap<K, V, H>::init_slots(const size_t n_buckets) {
+  this->n_buckets = n_buckets;
+  capacity.set_n_buckets(n_buckets);
+  slots.reset(new Slot[n_buckets]);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n_buckets; i++) {
+    slots[i].key.store(EMPTY_KEY, std::memory_order_relaxed);
+    slots[i].value.store(V(), std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < n_counters; i++) counters[i].n_keys.store(0, std::memory_order_relaxed);
+}
+
+template <class K, class V, class H>
+void AtomicHashMap<K, V, H>::init_free_slots(const size_t n_keys) {
+  const size_t n_max_keys = static_cast<size_t>(n_buckets * max_load_factor);
+  n_free_slots.store(n_max_keys > n_keys ? n_max_keys - n_keys : 0, std::memory_order_relaxed);
+  for (size_t i = 0; i < n_counters; i++) {
+    counters[i].n_free_slots.store(0, std::memory_order_relaxed);
+  }
+  full.store(false, std::memory_order_relaxed);
+}
+
+template <class K, class V, class H>
+bool AtomicHashMap<K, V, H>::acquire_free_slot(KeyCounter& counter) {
+  if (is_full()) return false;
+  if (take_free_slot(counter)) return true;
+  size_t n_shared_free_slots = n_free_slots.load(std::memory_order_relaxed);
+  while (n_shared_free_slots > 0) {
+    const size_t n_taken_slots = std::min(N_FREE_SLOTS_BATCH, n_shared_free_slots);
+    if (n_free_slots.compare_exchange_weak(
+            n_shared_free_slots,
+            n_shared_free_slots - n_taken_slots,
+            std::memory_order_relaxed)) {
+      counter.n_free_slots.fetch_add(n_taken_slots - 1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  // The slots left in the batches of the other threads.
+  for (size_t i = 0; i < n_counters; i++) {
+    if (take_free_slot(counters[i])) return true;
+  }
+  full.store(true);
+  return false;
+}
+
+template <class K, class V, class H>
+bool AtomicHashMap<K, V, H>::take_free_slot(KeyCounter& counter) {
+  size_t n_counter_free_slots = counter.n_free_slots.load(std::memory_order_relaxed);
+  while (n_counter_free_slots > 0) {
+    if (counter.n_free_slots.compare_exchange_weak(
+            n_counter_free_slots, n_counter_free_slots - 1, std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class K, class V, class H>
+void AtomicHashMap<K, V, H>::reserve(const size_t n_keys_min) {
+  const size_t n_buckets_min = std::max(n_keys_min, get_n_keys()) / max_load_factor;
+  if (n_buckets_min <= n_buckets && overflow.get_n_keys() == 0 && !is_full()) return;
+  std::vector<K> overflow_keys;
+  std::vector<size_t> overflow_hash_values;
+  std::vector<V> overflow_values;
+  overflow.for_each_serial([&](const K& key, const size_t hash_value, const V& value) {
+    overflow_keys.push_back(key);
+    overflow_hash_values.push_back(hash_value);
+    overflow_values.push_back(value);
+  });
+  overflow.clear();
+  const size_t n_old_buckets = n_buckets;
+  std::unique_ptr<Slot[]> old_slots(std::move(slots));
+  init_slots(PowerOfTwoCapacity::get_n_buckets(std::max(n_buckets_min, n_buckets)));
+  init_free_slots(0);
+  const auto& overwrite = Reducer<V>::overwrite;
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n_old_buckets; i++) {
+    const K key = old_slots[i].key.load(std::memory_order_relaxed);
+    if (key == EMPTY_KEY) continue;
+    set(key, hasher(key), old_slots[i].value.load(std::memory_order_relaxed), overwrite);
+  }
+  for (size_t i = 0; i < overflow_keys.size(); i++) {
+    set(overflow_keys[i], overflow_hash_values[i], overflow_values[i], overwrite);
+  }
+}
+
+template <class K, class V, class H>
+size_t AtomicHashMap<K, V, H>::get_n_keys() const {
+  size_t n_keys = overflow.get_n_keys();
+  for (size_t i = 0; i < n_counters; i++) {
+    n_keys += counters[i].n_keys.load(std::memory_order_relaxed);
+  }
+  return n_keys;
+}
+
+template <class K, class V, class H>
+template <class R>
+void AtomicHashMap<K, V, H>::set(
+    const K& key, const size_t hash_value, const V& value, const R& reducer) {
+  if (key >= BUSY_KEY) {
+    overflow.set(key, hash_value, value, reducer);
+    return;
+  }
+  size_t bucket_id = capacity.get_bucket_id(hash_value);
+  const size_t n_probes_max = std::min(MAX_N_PROBES, n_buckets);
+  size_t n_probes = 0;
+  while (n_probes < n_probes_max) {
+    Slot& slot = slots[bucket_id];
+    K slot_key = slot.key.load(std::memory_order_acquire);
+    if (slot_key == EMPTY_KEY) {
+      KeyCounter& counter = get_counter();
+      if (!acquire_free_slot(counter)) {
+        set_when_full(key, hash_value, value, reducer, bucket_id, n_probes);
+        return;
+      }
+      if (slot.key.compare_exchange_strong(slot_key, BUSY_KEY)) {
+        // Gives the slot up if another thread found the table full, so that the key does not
+        // also go to the overflow map from the threads that probed past this slot while empty.
+        if (!full.load()) {
+          slot.value.store(value, std::memory_order_relaxed);
+          slot.key.store(key, std::memory_order_release);
+          counter.n_keys.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        slot.key.store(EMPTY_KEY, std::memory_order_release);
+      }
+      counter.n_free_slots.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (slot_key == BUSY_KEY) slot_key = load_key(slot);
+    if (slot_key == EMPTY_KEY) continue;
+    if (slot_key == key) {
+      reduce(slot.value, value, reducer);
+      return;
+    }
+    bucket_id = next_bucket_id(bucket_id);
+    n_probes++;
+  }
+  // Slots are never emptied once set, so the probes of the key stay full and it is never in the
+  // table.
+  overflow.set(key, hash_value, value, reducer);
+}
+
+template <class K, class V, class H>
+template <class R>
+void AtomicHashMap<K, V, H>::set_when_full(
+    const K& key,
+    const size_t hash_value,
+    const V& value,
+    const R& reducer,
+    size_t bucket_id,
+    size_t n_probes) {
+  const size_t n_probes_max = std::min(MAX_N_PROBES, n_buckets);
+  while (n_probes < n_probes_max) {
+    // Sequentially consistent with the claims of the slots, which check full after claiming.
+    K slot_key = slots[bucket_id].key.load();
+    if (slot_key == BUSY_KEY) slot_key = load_key(slots[bucket_id]);
+    if (slot_key == EMPTY_KEY) break;
+    if (slot_key == key) {
+      reduce(slots[bucket_id].value, value, reducer);
+      return;
+    }
+    bucket_id = next_bucket_id(bucket_id);
+    n_probes++;
+  }
+  overflow.set(key, hash_value, value, reducer);
+}
+
+template <class K, class V, class H>
+V AtomicHashMap<K, V, H>::get(const K& key, const size_t hash_value, const V& default_value) const {
+  if (key >= BUSY_KEY) return overflow.get(key, hash_value, default_value);
+  size_t bucket_id = capacity.get_bucket_id(hash_value);
+  const size_t n_probes_max = std::min(MAX_N_PROBES, n_buckets);
+  for (size_t n_probes = 0; n_probes < n_probes_max; n_probes++) {
+    const K slot_key = load_key(slots[bucket_id]);
+    if (slot_key == EMPTY_KEY) {
+      if (!is_full()) return default_value;
+      break;
+    }
+    if (slot_key == key) return slots[bucket_id].value.load(std::memory_order_relaxed);
+    bucket_id = next_bucket_id(bucket_id);
+  }
+  return overflow.get(key, hash_value, default_value);
+}
+
+template <class K, class V, class H>
+bool AtomicHashMap<K, V, H>::has(const K& key, const size_t hash_value) const {
+  if (key >= BUSY_KEY) return overflow.has(key, hash_value);
+  size_t bucket_id = capacity.get_bucket_id(hash_value);
+  const size_t n_probes_max = std::min(MAX_N_PROBES, n_buckets);
+  for (size_t n_probes = 0; n_probes < n_probes_max; n_probes++) {
+    const K slot_key = load_key(slots[bucket_id]);
+    if (slot_key == EMPTY_KEY) {
+      if (!is_full()) return false;
+      break;
+    }
+    if (slot_key == key) return true;
+    bucket_id = next_bucket_id(bucket_id);
+  }
+  return overflow.has(key, hash_value);
+}
+
+template <class K, class V, class H>
+template <class F>
+void AtomicHashMap<K, V, H>::for_each(const F& handler) const {
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n_buckets; i++) {
+    const K key = load_key(slots[i]);
+    if (key == EMPTY_KEY) continue;
+    handler(key, hasher(key), slots[i].value.load(std::memory_order_relaxed));
+  }
+  overflow.for_each(handler);
+}
+
+template <class K, class V, class H>
+template <class F>
+void AtomicHashMap<K, V, H>::for_each_serial(const F& handler) const {
+  for (size_t i = 0; i < n_buckets; i++) {
+    const K key = load_key(slots[i]);
+    if (key == EMPTY_KEY) continue;
+    handler(key, hasher(key), slots[i].value.load(std::memory_order_relaxed));
+  }
+  overflow.for_each_serial(handler);
+}
+
+template <class K, class V, class H>
+void AtomicHashMap<K, V, H>::clear() {
+  init_slots(n_buckets);
+  init_free_slots(0);
+  overflow.clear();
+}
+
+template <class K, class V, class H>
+K AtomicHashMap<K, V, H>::load_key(const Slot& slot) {
+  K key = slot.key.load(std::memory_order_acquire);
+  while (key == BUSY_KEY) {
+    std::this_thread::yield();
+    key = slot.key.load(std::memory_order_acquire);
+  }
+  return key;
+}
+
+template <class K, class V, class H>
+template <class R>
+void AtomicHashMap<K, V, H>::reduce(std::atomic<V>& slot_value, const V& value, const R& reducer) {
+  V expected = slot_value.load(std::memory_order_relaxed);
+  V desired = expected;
+  reducer(desired, value);
+  while (!slot_value.compare_exchange_weak(expected, desired, std::memory_order_relaxed)) {
+    desired = expected;
+    reducer(desired, value);
+  }
+}
+
+template <class K, class V, class H>
+void AtomicHashMap<K, V, H>::reduce(
+    std::atomic<V>& slot_value, const V& value, const typename Reducer<V>::Sum&) {
+  fetch_add(slot_value, value, std::is_integral<V>());
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// Scrambles the hash value with a nonzero seed, so that the keys clustered under one seed spread
+// out under another. A zero seed keeps the hash value.
+inline size_t mix_seed(const size_t hash_value, const size_t seed) {
+  if (seed == 0) return hash_value;
+  uint64_t mixed = (hash_value ^ seed) * 0xBF58476D1CE4E5B9ull;
+  mixed ^= mixed >> 31;
+  return static_cast<size_t>(mixed);
+}
+
+// Bucket counts built from products of primes, with hash values taken modulo the count.
+// Tolerates weak hashers such as the identity std::hash of integers.
+class PrimeCapacity {
+ public:
+  constexpr static size_t N_INITIAL_BUCKETS = 17;
+
+  // Identifies the policy in saved tables.
+  constexpr static uint64_t TAG = 1;
+
+  PrimeCapacity() : n_buckets(N_INITIAL_BUCKETS), seed(0) {}
+
+  static size_t get_n_buckets(const size_t n_buckets_min);
+
+  static bool is_valid_n_buckets(const size_t n_buckets) { return n_buckets > 0; }
+
+  void set_n_buckets(const size_t n_buckets) { this->n_buckets = n_buckets; }
+
+  void set_seed(const size_t seed) { this->seed = seed; }
+
+  size_t get_seed() const { return seed; }
+
+  size_t get_bucket_id(const size_t hash_value) const {
+    return mix_seed(hash_value, seed) % n_buckets;
+  }
+
+ private:
+  size_t n_buckets;
+
+  size_t seed;
+};
+
+// Power of two bucket counts, with the bucket id taken from the high bits of a Fibonacci
+// multiplicative hash, which avoids the integer division of PrimeCapacity.
+class PowerOfTwoCapacity {
+ public:
+  constexpr static size_t N_INITIAL_BUCKETS = 16;
+
+  constexpr static uint64_t TAG = 2;
+
+  PowerOfTwoCapacity() : seed(0) { set_n_buckets(N_INITIAL_BUCKETS); }
+
+  static size_t get_n_buckets(const size_t n_buckets_min);
+
+  // Greater than 1 as well, so that the shift stays below the width of size_t.
+  static bool is_valid_n_buckets(const size_t n_buckets) {
+    return n_buckets > 1 && (n_buckets & (n_buckets - 1)) == 0;
+  }
+
+  void set_n_buckets(const size_t n_buckets) {
+    shift = sizeof(size_t) * 8 - __builtin_ctzll(n_buckets);
+  }
+
+  void set_seed(const size_t seed) { this->seed = seed; }
+
+  size_t get_seed() const { return seed; }
+
+  size_t get_bucket_id(const size_t hash_value) const {
+    return (mix_seed(hash_value, seed) * static_cast<size_t>(0x9E3779B97F4A7C15ull)) >> shift;
+  }
+
+ private:
+  size_t shift;
+
+  size_t seed;
+};
+
+inline size_t PrimeCapacity::get_n_buckets(const size_t n_buckets_min) {
+  if (n_buckets_min <= N_INITIAL_BUCKETS) return N_INITIAL_BUCKETS;
+  constexpr size_t PRIMES[] = {
+      13, 17, 23, 29, 37, 47, 61, 79, 101, 127, 163, 211, 271, 337, 439, 547, 709, 887, 1153, 1433,
+      1861, 2311, 3001, 3739, 4861, 6053, 7867, 9791, 12721, 15859, 20611, 26783, 34841};
+  constexpr size_t N_PRIMES = sizeof(PRIMES) / sizeof(size_t);
+  constexpr size_t LAST_PRIME = PRIMES[N_PRIMES - 1];
+  constexpr size_t BIG_PRIME = PRIMES[N_PRIMES - 10];
+  size_t remaining_factor = n_buckets_min + n_buckets_min / 8;
+  size_t n_rehash_buckets = 1;
+  while (remaining_factor > LAST_PRIME) {
+    remaining_factor /= BIG_PRIME;
+    n_rehash_buckets *= BIG_PRIME;
+  }
+
+  // Find a prime larger than or equal to the remaining factor with binary search.
+  size_t left = 0, right = N_PRIMES - 1;
+  while (left < right) {
+    size_t mid = (left + right) / 2;
+    if (PRIMES[mid] < remaining_factor) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  n_rehash_buckets *= PRIMES[left];
+  return n_rehash_buckets;
+}
+
+inline size_t PowerOfTwoCapacity::get_n_buckets(const size_t n_buckets_min) {
+  size_t n_rehash_buckets = N_INITIAL_BUCKETS;
+  while (n_rehash_buckets < n_buckets_min) n_rehash_buckets <<= 1;
+  return n_rehash_buckets;
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
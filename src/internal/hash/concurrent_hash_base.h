@@ -1,23 +1,44 @@
 #pragma once
 
 #include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <functional>
+#include <iterator>
 #include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include "../lock.h"
+#include "../numa.h"
+#include "hash_base.h"
 
 namespace fgpl {
 namespace internal {
 namespace hash {
 
 // A concurrent map that requires providing hash values when use.
-template <class K, class V, class S, class H = std::hash<K>>
+// Each segment has a version, odd while a write holds the segment lock. Segments of trivially
+// copyable entries are read without the lock: the read retries when the version changes under
+// it, and the writes that replace the bucket arrays first wait for the readers inside the segment.
+// The segment locks are of the lock policy L, see lock.h.
+// Each segment and thread cache is allocated by the thread that owns it, so that first touch places
+// the thread caches on the nodes of their threads and interleaves the segments across the nodes
+// the threads run on. The nodes are queried at construction, so bind the threads, e.g. with
+// OMP_PROC_BIND, for the placement to hold.
+// The try-locks of async_set are counted per segment, and sync re-segments the map into more
+// segments when too many of them failed.
+template <class K, class V, class S, class H = std::hash<K>, class L = OmpLock>
 class ConcurrentHashBase {
  public:
   ConcurrentHashBase();
 
   ConcurrentHashBase(const ConcurrentHashBase& m);
 
-  ~ConcurrentHashBase();
+  ConcurrentHashBase& operator=(const ConcurrentHashBase& m);
 
   void reserve(const size_t n_keys_min);
 
@@ -25,6 +46,24 @@ class ConcurrentHashBase {
 
   float get_max_load_factor() const { return max_load_factor; };
 
+  // Spreads the rehash of each segment over the following writes to it, so that no write holds
+  // the segment lock for a whole rehash.
+  void set_incremental_rehash(const bool incremental_rehash);
+
+  bool get_incremental_rehash() const { return incremental_rehash; }
+
+  // Segments shrink to fit when erase_if leaves them below this load factor. 0 never shrinks.
+  void set_min_load_factor(const float min_load_factor);
+
+  float get_min_load_factor() const { return min_load_factor; }
+
+  // Sets the handler called after a segment or thread cache reseeds, which may run on any thread
+  // writing to the map.
+  void set_unbalanced_handler(const std::function<void(const HashStats& stats)>& handler);
+
+  // The stats of all the segments merged.
+  HashStats get_stats() const;
+
   size_t get_n_keys() const;
 
   size_t get_n_buckets() const;
@@ -33,12 +72,122 @@ class ConcurrentHashBase {
 
   void unset(const K& key, const size_t hash_value);
 
-  bool has(const K& key, const size_t hash_value);
+  bool has(const K& key, const size_t hash_value) const;
+
+  // May run concurrently with the writes, as has does. Only the prefetches go unsynchronized.
+  void has_many(const K* keys, const size_t* hash_values, const size_t n, bool* res) const;
 
   void clear();
 
   void clear_and_shrink();
 
+  void shrink_to_fit();
+
+  // Erases the entries for which pred is true, with the segments compacted in parallel, each in a
+  // single pass under its lock. pred takes the arguments of the for_each handlers and must be safe
+  // to call from multiple threads. Entries pending in the thread caches are not visited, so call
+  // it after sync. Returns the number of entries erased.
+  template <class F>
+  size_t erase_if(const F& pred);
+
+  // Keeps only the entries for which pred is true. Returns the number of entries erased.
+  template <class F>
+  size_t retain(const F& pred);
+
+  size_t get_n_segments() const { return n_segments; }
+
+  // The fraction of the async_set try-locks that failed since the last re-segmenting check.
+  float get_contention() const;
+
+  // sync multiplies the segments by N_SEGMENTS_GROWTH, up to N_MAX_SEGMENTS_PER_THREAD per thread,
+  // when at least this fraction of N_CONTENTION_SAMPLES_MIN or more try-locks failed. Values above
+  // 1 never re-segment.
+  void set_max_contention(const float max_contention) { this->max_contention = max_contention; }
+
+  float get_max_contention() const { return max_contention; }
+
+  constexpr static float DEFAULT_MAX_CONTENTION = 0.1f;
+
+  constexpr static size_t N_CONTENTION_SAMPLES_MIN = 10000;
+
+  constexpr static size_t N_SEGMENTS_GROWTH = 4;
+
+  constexpr static size_t N_MAX_SEGMENTS_PER_THREAD = 64;
+
+  // Iterators over the entries of one segment, so that threads can scan disjoint segments, e.g.
+  // with an omp parallel for over the segment ids. Entries pending in the thread caches are not
+  // visited, and concurrent writes invalidate them.
+  typename S::Iterator segment_begin(const size_t segment_id) const {
+    return segments[segment_id].begin();
+  }
+
+  typename S::Iterator segment_end(const size_t segment_id) const {
+    return segments[segment_id].end();
+  }
+
+  // A forward iterator over all the segments one after another.
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+
+    using value_type = typename S::Iterator;
+
+    using difference_type = std::ptrdiff_t;
+
+    using pointer = const typename S::Iterator*;
+
+    using reference = const typename S::Iterator&;
+
+    Iterator() : base(nullptr), segment_id(0) {}
+
+    Iterator(const ConcurrentHashBase* base, const size_t segment_id)
+        : base(base), segment_id(segment_id) {
+      if (segment_id < base->n_segments) it = base->segment_begin(segment_id);
+      skip_ended_segments();
+    }
+
+    reference operator*() const { return *it; }
+
+    pointer operator->() const { return &it; }
+
+    Iterator& operator++() {
+      ++it;
+      skip_ended_segments();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return segment_id == other.segment_id && it == other.it;
+    }
+
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    const ConcurrentHashBase* base;
+
+    size_t segment_id;
+
+    typename S::Iterator it;
+
+    void skip_ended_segments() {
+      while (segment_id < base->n_segments && it == base->segment_end(segment_id)) {
+        segment_id++;
+        it = typename S::Iterator();
+        if (segment_id < base->n_segments) it = base->segment_begin(segment_id);
+      }
+    }
+  };
+
+  Iterator begin() const { return Iterator(this, 0); }
+
+  Iterator end() const { return Iterator(this, n_segments); }
+
  protected:
   size_t n_segments;
 
@@ -48,103 +197,500 @@ class ConcurrentHashBase {
 
   std::vector<S> thread_caches;
 
-  std::vector<omp_lock_t> segment_locks;
+  // Takes the segment lock for a write and makes the version odd until unlock_segment.
+  void lock_segment(const size_t segment_id);
+
+  bool try_lock_segment(const size_t segment_id);
+
+  void unlock_segment(const size_t segment_id);
+
+  // Returns reader(segment), a read of the segment that may run concurrently with writes.
+  template <class T, class F>
+  T read_segment(const size_t segment_id, const F& reader) const;
+
+  // Replaces the segments with n_segments empty ones, each reserved for an even share of n_keys,
+  // and returns the old ones for the caller to move the entries over. Not safe concurrently with
+  // any other operation.
+  std::vector<S> reset_segments(const size_t n_segments, const size_t n_keys);
+
+  // Returns the number of segments to re-segment into for the contention counted so far, which is
+  // n_segments to keep them. Resets the counts once there are enough samples.
+  size_t get_adapted_n_segments();
 
  private:
+  // The lock, version and contention counts of a segment, on a cache line of their own.
+  struct alignas(CACHE_LINE_SIZE) SegmentSync {
+    L lock;
+
+    std::atomic<size_t> version;
+
+    // Counted under the lock.
+    size_t n_try_locks;
+
+    std::atomic<size_t> n_failed_try_locks;
+
+    SegmentSync() : version(0), n_try_locks(0), n_failed_try_locks(0) {}
+  };
+
+  // Indexed by ThreadIndex, on different cache lines for different threads.
+  struct alignas(CACHE_LINE_SIZE) ReaderSlot {
+    // The id of the segment being read plus one, or 0.
+    std::atomic<size_t> segment_id;
+
+    ReaderSlot() : segment_id(0) {}
+  };
+
+  // Entries that reference no other memory, so that a read racing with a write reads garbage at
+  // worst, which the version check then discards.
+  constexpr static bool OPTIMISTIC_READS =
+      std::is_trivially_copyable<HashEntry<K, V, H>>::value &&
+      std::is_same<typename HashEntry<K, V, H>::Store, NoKeyStore>::value;
+
+  constexpr static size_t N_OPTIMISTIC_READ_TRIES = 4;
+
   float max_load_factor;
+
+  float min_load_factor;
+
+  bool incremental_rehash;
+
+  float max_contention;
+
+  mutable CacheLineArray<SegmentSync> segment_syncs;
+
+  mutable CacheLineArray<ReaderSlot> reader_slots;
+
+  // The thread that allocates each segment.
+  std::vector<size_t> segment_owners;
+
+  // Assigns the segments to the threads, spread over the nodes the threads run on.
+  void init_segment_owners(const std::vector<size_t>& thread_nodes);
+
+  // Assigns the segment owners and calls segment_handler(segment_id) on the owner of each segment
+  // and thread_cache_handler(thread_id) on the thread of each thread cache, all in one parallel
+  // region.
+  template <class FS, class FT>
+  void init_owned(const FS& segment_handler, const FT& thread_cache_handler);
+
+  // An empty thread cache with the settings of the map.
+  S make_thread_cache(const std::function<void(const HashStats& stats)>& unbalanced_handler) const;
+
+  // Calls handler(segment_id) on the owner thread of each segment.
+  template <class F>
+  void for_each_owned_segment(const F& handler);
+
+  // Calls handler(thread_id) on the thread of each thread cache.
+  template <class F>
+  void for_each_owned_thread_cache(const F& handler);
+
+  void init_segment_sync();
+
+  void wait_for_readers(const size_t segment_id) const;
 };
 
-template <class K, class V, class S, class H>
-ConcurrentHashBase<K, V, S, H>::ConcurrentHashBase() {
+template <class K, class V, class S, class H, class L>
+ConcurrentHashBase<K, V, S, H, L>::ConcurrentHashBase() {
   max_load_factor = S::DEFAULT_MAX_LOAD_FACTOR;
+  min_load_factor = 0.0f;
+  incremental_rehash = false;
+  max_contention = DEFAULT_MAX_CONTENTION;
   n_threads = omp_get_max_threads();
   thread_caches.resize(n_threads);
   n_segments = 4;
   while (n_segments < n_threads) n_segments <<= 1;
   n_segments <<= 2;
   segments.resize(n_segments);
-  segment_locks.resize(n_segments);
-  for (auto& lock : segment_locks) omp_init_lock(&lock);
+  init_owned(
+      [&](const size_t i) { segments[i] = S(); },
+      [&](const size_t i) { thread_caches[i] = S(); });
+  init_segment_sync();
 }
 
-template <class K, class V, class S, class H>
-ConcurrentHashBase<K, V, S, H>::ConcurrentHashBase(const ConcurrentHashBase& m) {
+template <class K, class V, class S, class H, class L>
+ConcurrentHashBase<K, V, S, H, L>::ConcurrentHashBase(const ConcurrentHashBase& m) {
   max_load_factor = m.max_load_factor;
+  min_load_factor = m.min_load_factor;
+  incremental_rehash = m.incremental_rehash;
+  max_contention = m.max_contention;
   n_threads = omp_get_max_threads();
   thread_caches.resize(n_threads);
   n_segments = m.n_segments;
-  segments = m.segments;
-  segment_locks.resize(n_segments);
-  for (auto& lock : segment_locks) omp_init_lock(&lock);
+  segments.resize(n_segments);
+  const auto& unbalanced_handler = m.segments.at(0).unbalanced_handler;
+  init_owned(
+      [&](const size_t i) { segments[i] = m.segments[i]; },
+      [&](const size_t i) { thread_caches[i] = make_thread_cache(unbalanced_handler); });
+  init_segment_sync();
+}
+
+template <class K, class V, class S, class H, class L>
+ConcurrentHashBase<K, V, S, H, L>& ConcurrentHashBase<K, V, S, H, L>::operator=(
+    const ConcurrentHashBase& m) {
+  if (this == &m) return *this;
+  max_load_factor = m.max_load_factor;
+  min_load_factor = m.min_load_factor;
+  incremental_rehash = m.incremental_rehash;
+  max_contention = m.max_contention;
+  n_segments = m.n_segments;
+  segments.resize(n_segments);
+  const auto& unbalanced_handler = m.segments.at(0).unbalanced_handler;
+  init_owned(
+      [&](const size_t i) { segments[i] = m.segments[i]; },
+      [&](const size_t i) { thread_caches[i] = make_thread_cache(unbalanced_handler); });
+  init_segment_sync();
+  return *this;
+}
+
+template <class K, class V, class S, class H, class L>
+template <class FS, class FT>
+void ConcurrentHashBase<K, V, S, H, L>::init_owned(
+    const FS& segment_handler, const FT& thread_cache_handler) {
+  std::vector<size_t> thread_nodes(n_threads, 0);
+#pragma omp parallel
+  {
+    const size_t thread_id = omp_get_thread_num();
+    const size_t n_team_threads = omp_get_num_threads();
+    if (thread_id < n_threads) thread_nodes[thread_id] = NumaTopology::get_current_node();
+#pragma omp barrier
+#pragma omp single
+    init_segment_owners(thread_nodes);
+    for (size_t i = 0; i < n_segments; i++) {
+      if (segment_owners[i] % n_team_threads == thread_id) segment_handler(i);
+    }
+    for (size_t i = thread_id; i < n_threads; i += n_team_threads) thread_cache_handler(i);
+  }
 }
 
-template <class K, class V, class S, class H>
-ConcurrentHashBase<K, V, S, H>::~ConcurrentHashBase() {
-  for (auto& lock : segment_locks) omp_destroy_lock(&lock);
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::init_segment_owners(
+    const std::vector<size_t>& thread_nodes) {
+  const size_t n_nodes = NumaTopology::get_n_nodes();
+  std::vector<std::vector<size_t>> node_threads(n_nodes);
+  for (size_t i = 0; i < n_threads; i++) node_threads[thread_nodes[i]].push_back(i);
+  std::vector<std::vector<size_t>> used_node_threads;
+  for (auto& threads : node_threads) {
+    if (!threads.empty()) used_node_threads.push_back(std::move(threads));
+  }
+  // Consecutive segments go to different nodes, and then to different threads of the node.
+  const size_t n_used_nodes = used_node_threads.size();
+  segment_owners.resize(n_segments);
+  for (size_t i = 0; i < n_segments; i++) {
+    const std::vector<size_t>& threads = used_node_threads[i % n_used_nodes];
+    segment_owners[i] = threads[i / n_used_nodes % threads.size()];
+  }
 }
 
-template <class K, class V, class S, class H>
-void ConcurrentHashBase<K, V, S, H>::reserve(const size_t n_keys_min) {
+template <class K, class V, class S, class H, class L>
+S ConcurrentHashBase<K, V, S, H, L>::make_thread_cache(
+    const std::function<void(const HashStats& stats)>& unbalanced_handler) const {
+  S thread_cache;
+  thread_cache.max_load_factor = max_load_factor;
+  thread_cache.incremental_rehash = incremental_rehash;
+  thread_cache.unbalanced_handler = unbalanced_handler;
+  return thread_cache;
+}
+
+template <class K, class V, class S, class H, class L>
+template <class F>
+void ConcurrentHashBase<K, V, S, H, L>::for_each_owned_segment(const F& handler) {
+#pragma omp parallel
+  {
+    // Teams smaller than n_threads, such as in nested regions, share out the segments.
+    const size_t thread_id = omp_get_thread_num();
+    const size_t n_team_threads = omp_get_num_threads();
+    for (size_t i = 0; i < n_segments; i++) {
+      if (segment_owners[i] % n_team_threads == thread_id) handler(i);
+    }
+  }
+}
+
+template <class K, class V, class S, class H, class L>
+template <class F>
+void ConcurrentHashBase<K, V, S, H, L>::for_each_owned_thread_cache(const F& handler) {
+#pragma omp parallel
+  {
+    const size_t thread_id = omp_get_thread_num();
+    const size_t n_team_threads = omp_get_num_threads();
+    for (size_t i = thread_id; i < n_threads; i += n_team_threads) handler(i);
+  }
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::init_segment_sync() {
+  segment_syncs.reset(n_segments);
+  reader_slots.reset(n_threads);
+  for (size_t i = 0; i < n_segments; i++) {
+    if (OPTIMISTIC_READS) {
+      segments[i].reallocate_handler = [this, i]() { wait_for_readers(i); };
+    } else {
+      segments[i].reallocate_handler = nullptr;
+    }
+  }
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::lock_segment(const size_t segment_id) {
+  segment_syncs[segment_id].lock.lock();
+  std::atomic<size_t>& version = segment_syncs[segment_id].version;
+  version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  // Orders the odd version before both the writes and the reads of the reader slots.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+template <class K, class V, class S, class H, class L>
+bool ConcurrentHashBase<K, V, S, H, L>::try_lock_segment(const size_t segment_id) {
+  SegmentSync& segment_sync = segment_syncs[segment_id];
+  if (!segment_sync.lock.try_lock()) {
+    segment_sync.n_failed_try_locks.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  segment_sync.n_try_locks++;
+  std::atomic<size_t>& version = segment_sync.version;
+  version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return true;
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::unlock_segment(const size_t segment_id) {
+  std::atomic<size_t>& version = segment_syncs[segment_id].version;
+  version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  segment_syncs[segment_id].lock.unlock();
+}
+
+template <class K, class V, class S, class H, class L>
+template <class T, class F>
+T ConcurrentHashBase<K, V, S, H, L>::read_segment(const size_t segment_id, const F& reader) const {
+  // Threads beyond the slots, such as those of nested teams, take the lock.
+  const size_t thread_index = ThreadIndex::get();
+  if (OPTIMISTIC_READS && thread_index < n_threads) {
+    std::atomic<size_t>& reader_segment_id = reader_slots[thread_index].segment_id;
+    const std::atomic<size_t>& version = segment_syncs[segment_id].version;
+    for (size_t i = 0; i < N_OPTIMISTIC_READ_TRIES; i++) {
+      // Announced before loading the version, so that a write either sees the announcement and
+      // waits, or has made the version odd before the load.
+      reader_segment_id.store(segment_id + 1, std::memory_order_seq_cst);
+      const size_t version_begin = version.load(std::memory_order_seq_cst);
+      if (version_begin & 1) {
+        reader_segment_id.store(0, std::memory_order_release);
+        break;
+      }
+      const T res = reader(segments[segment_id]);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const bool unchanged = version.load(std::memory_order_relaxed) == version_begin;
+      reader_segment_id.store(0, std::memory_order_release);
+      if (unchanged) return res;
+    }
+  }
+  segment_syncs[segment_id].lock.lock();
+  const T res = reader(segments[segment_id]);
+  segment_syncs[segment_id].lock.unlock();
+  return res;
+}
+
+template <class K, class V, class S, class H, class L>
+std::vector<S> ConcurrentHashBase<K, V, S, H, L>::reset_segments(
+    const size_t n_segments, const size_t n_keys) {
+  if (n_segments == 0) throw std::invalid_argument("n_segments must be positive.");
+  std::vector<S> old_segments;
+  old_segments.swap(segments);
+  for (auto& segment : old_segments) segment.reallocate_handler = nullptr;
+  const auto unbalanced_handler = old_segments.at(0).unbalanced_handler;
+  this->n_segments = n_segments;
+  segments.resize(n_segments);
+  init_owned(
+      [&](const size_t i) {
+        S segment;
+        segment.max_load_factor = max_load_factor;
+        segment.min_load_factor = min_load_factor;
+        segment.incremental_rehash = incremental_rehash;
+        segment.unbalanced_handler = unbalanced_handler;
+        segment.reserve(n_keys / n_segments);
+        segments[i] = std::move(segment);
+      },
+      [](const size_t) {});
+  init_segment_sync();
+  return old_segments;
+}
+
+template <class K, class V, class S, class H, class L>
+size_t ConcurrentHashBase<K, V, S, H, L>::get_adapted_n_segments() {
+  size_t n_try_locks = 0;
+  size_t n_failed_try_locks = 0;
+  for (size_t i = 0; i < n_segments; i++) {
+    n_try_locks += segment_syncs[i].n_try_locks;
+    n_failed_try_locks += segment_syncs[i].n_failed_try_locks.load(std::memory_order_relaxed);
+  }
+  n_try_locks += n_failed_try_locks;
+  if (n_try_locks < N_CONTENTION_SAMPLES_MIN) return n_segments;
+  for (size_t i = 0; i < n_segments; i++) {
+    segment_syncs[i].n_try_locks = 0;
+    segment_syncs[i].n_failed_try_locks.store(0, std::memory_order_relaxed);
+  }
+  const size_t n_max_segments = n_threads * N_MAX_SEGMENTS_PER_THREAD;
+  if (n_failed_try_locks < max_contention * n_try_locks || n_segments >= n_max_segments) {
+    return n_segments;
+  }
+  return std::min(n_segments * N_SEGMENTS_GROWTH, n_max_segments);
+}
+
+template <class K, class V, class S, class H, class L>
+float ConcurrentHashBase<K, V, S, H, L>::get_contention() const {
+  size_t n_try_locks = 0;
+  size_t n_failed_try_locks = 0;
+  for (size_t i = 0; i < n_segments; i++) {
+    n_try_locks += segment_syncs[i].n_try_locks;
+    n_failed_try_locks += segment_syncs[i].n_failed_try_locks.load(std::memory_order_relaxed);
+  }
+  n_try_locks += n_failed_try_locks;
+  if (n_try_locks == 0) return 0.0f;
+  return static_cast<float>(n_failed_try_locks) / n_try_locks;
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::wait_for_readers(const size_t segment_id) const {
+  for (size_t i = 0; i < n_threads; i++) {
+    while (reader_slots[i].segment_id.load(std::memory_order_seq_cst) == segment_id + 1) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::reserve(const size_t n_keys_min) {
   const size_t n_segment_keys_min = n_keys_min / n_segments;
-  for (size_t i = 0; i < n_segments; i++) segments.at(i).reserve(n_segment_keys_min);
+  for_each_owned_segment([&](const size_t i) { segments[i].reserve(n_segment_keys_min); });
   const size_t n_thread_keys_est = n_keys_min / 1000;
-  for (size_t i = 0; i < n_threads; i++) thread_caches.at(i).reserve(n_thread_keys_est);
+  for_each_owned_thread_cache([&](const size_t i) { thread_caches[i].reserve(n_thread_keys_est); });
 };
 
-template <class K, class V, class S, class H>
-void ConcurrentHashBase<K, V, S, H>::set_max_load_factor(const float max_load_factor) {
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::set_max_load_factor(const float max_load_factor) {
   this->max_load_factor = max_load_factor;
   for (size_t i = 0; i < n_segments; i++) segments.at(i).max_load_factor = max_load_factor;
   for (size_t i = 0; i < n_threads; i++) thread_caches.at(i).max_load_factor = max_load_factor;
 }
 
-template <class K, class V, class S, class H>
-size_t ConcurrentHashBase<K, V, S, H>::get_n_keys() const {
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::set_incremental_rehash(const bool incremental_rehash) {
+  this->incremental_rehash = incremental_rehash;
+  for (size_t i = 0; i < n_segments; i++) segments.at(i).incremental_rehash = incremental_rehash;
+  for (size_t i = 0; i < n_threads; i++) {
+    thread_caches.at(i).incremental_rehash = incremental_rehash;
+  }
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::set_min_load_factor(const float min_load_factor) {
+  this->min_load_factor = min_load_factor;
+  for (size_t i = 0; i < n_segments; i++) segments.at(i).min_load_factor = min_load_factor;
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::set_unbalanced_handler(
+    const std::function<void(const HashStats& stats)>& handler) {
+  for (size_t i = 0; i < n_segments; i++) segments.at(i).unbalanced_handler = handler;
+  for (size_t i = 0; i < n_threads; i++) thread_caches.at(i).unbalanced_handler = handler;
+}
+
+template <class K, class V, class S, class H, class L>
+HashStats ConcurrentHashBase<K, V, S, H, L>::get_stats() const {
+  HashStats stats;
+  for (size_t i = 0; i < n_segments; i++) stats.merge(segments.at(i).get_stats());
+  return stats;
+}
+
+template <class K, class V, class S, class H, class L>
+size_t ConcurrentHashBase<K, V, S, H, L>::get_n_keys() const {
   size_t n_keys = 0;
   for (size_t i = 0; i < n_segments; i++) n_keys += segments.at(i).get_n_keys();
   return n_keys;
 }
 
-template <class K, class V, class S, class H>
-size_t ConcurrentHashBase<K, V, S, H>::get_n_buckets() const {
+template <class K, class V, class S, class H, class L>
+size_t ConcurrentHashBase<K, V, S, H, L>::get_n_buckets() const {
   size_t n_buckets = 0;
   for (size_t i = 0; i < n_segments; i++) n_buckets += segments.at(i).get_n_buckets();
   return n_buckets;
 }
 
-template <class K, class V, class S, class H>
-void ConcurrentHashBase<K, V, S, H>::unset(const K& key, const size_t hash_value) {
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::unset(const K& key, const size_t hash_value) {
   const size_t segment_id = hash_value % n_segments;
-  auto& lock = segment_locks[segment_id];
-  omp_set_lock(&lock);
+  lock_segment(segment_id);
   segments.at(segment_id).unset(key, hash_value);
-  omp_unset_lock(&lock);
+  unlock_segment(segment_id);
 }
 
-template <class K, class V, class S, class H>
-bool ConcurrentHashBase<K, V, S, H>::has(const K& key, const size_t hash_value) {
-  const size_t segment_id = hash_value % n_segments;
-  auto& lock = segment_locks[segment_id];
-  omp_set_lock(&lock);
-  bool res = segments.at(segment_id).has(key, hash_value);
-  omp_unset_lock(&lock);
-  return res;
+template <class K, class V, class S, class H, class L>
+bool ConcurrentHashBase<K, V, S, H, L>::has(const K& key, const size_t hash_value) const {
+  return read_segment<bool>(
+      hash_value % n_segments, [&](const S& segment) { return segment.has(key, hash_value); });
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::has_many(
+    const K* keys, const size_t* hash_values, const size_t n, bool* res) const {
+  const size_t n_ahead = S::N_PREFETCH_AHEAD;
+  for (size_t i = 0; i < n && i < n_ahead; i++) {
+    segments[hash_values[i] % n_segments].prefetch(hash_values[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (i + n_ahead < n) {
+      const size_t hash_value = hash_values[i + n_ahead];
+      segments[hash_value % n_segments].prefetch(hash_value);
+    }
+    res[i] = read_segment<bool>(hash_values[i] % n_segments, [&](const S& segment) {
+      return segment.has(keys[i], hash_values[i]);
+    });
+  }
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::clear() {
+  for_each_owned_segment([&](const size_t i) { segments[i].clear(); });
+  for_each_owned_thread_cache([&](const size_t i) { thread_caches[i].clear(); });
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::clear_and_shrink() {
+  for_each_owned_segment([&](const size_t i) { segments[i].clear_and_shrink(); });
+  for_each_owned_thread_cache([&](const size_t i) { thread_caches[i].clear_and_shrink(); });
+}
+
+template <class K, class V, class S, class H, class L>
+void ConcurrentHashBase<K, V, S, H, L>::shrink_to_fit() {
+  for_each_owned_segment([&](const size_t i) {
+    lock_segment(i);
+    segments[i].shrink_to_fit();
+    unlock_segment(i);
+  });
 }
 
-template <class K, class V, class S, class H>
-void ConcurrentHashBase<K, V, S, H>::clear() {
-#pragma omp parallel for
-  for (size_t i = 0; i < n_segments; i++) segments.at(i).clear();
-#pragma omp parallel for
-  for (size_t i = 0; i < n_threads; i++) thread_caches.at(i).clear();
+template <class K, class V, class S, class H, class L>
+template <class F>
+size_t ConcurrentHashBase<K, V, S, H, L>::erase_if(const F& pred) {
+  size_t n_erased_keys = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : n_erased_keys)
+  for (size_t i = 0; i < n_segments; i++) {
+    lock_segment(i);
+    n_erased_keys += segments[i].erase_if(pred);
+    unlock_segment(i);
+  }
+  return n_erased_keys;
 }
 
-template <class K, class V, class S, class H>
-void ConcurrentHashBase<K, V, S, H>::clear_and_shrink() {
-#pragma omp parallel for
-  for (size_t i = 0; i < n_segments; i++) segments.at(i).clear_and_shrink();
-#pragma omp parallel for
-  for (size_t i = 0; i < n_threads; i++) thread_caches.at(i).clear_and_shrink();
+template <class K, class V, class S, class H, class L>
+template <class F>
+size_t ConcurrentHashBase<K, V, S, H, L>::retain(const F& pred) {
+  size_t n_erased_keys = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : n_erased_keys)
+  for (size_t i = 0; i < n_segments; i++) {
+    lock_segment(i);
+    n_erased_keys += segments[i].retain(pred);
+    unlock_segment(i);
+  }
+  return n_erased_keys;
 }
 
 }  // namespace hash
@@ -8,37 +8,76 @@ namespace fgpl {
 namespace internal {
 namespace hash {
 
-template <class K, class V, class H = std::hash<K>>
-class ConcurrentHashMap : public ConcurrentHashBase<K, V, HashMap<K, V, H>, H> {
+// The segments and thread caches of concurrent maps.
+template <class K, class V, class H, template <class> class A>
+using MapSegment = HashMap<K, V, H, PrimeCapacity, LinearProbing, A>;
+
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    template <class> class A = std::allocator,
+    class L = OmpLock>
+class ConcurrentHashMap : public ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L> {
  public:
-  void set(
-      const K& key,
-      const size_t hash_value,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer);
+  // The key of set, async_set and get may be of any type Q the hasher accepts in place of K,
+  // see IsTransparentKey.
+  template <class Q, class R>
+  void set(const Q& key, const size_t hash_value, const V& value, const R& reducer);
+
+  template <class Q, class R>
+  void async_set(const Q& key, const size_t hash_value, const V& value, const R& reducer);
+
+  // May run concurrently with the writes, see ConcurrentHashBase::read_segment.
+  template <class Q>
+  V get(const Q& key, const size_t hash_value, const V& default_value) const;
+
+  // Returns the value of the key in place, or nullptr if not found. Takes no locks, so is only
+  // for phases without concurrent writes, such as after sync.
+  template <class Q>
+  const V* find(const Q& key, const size_t hash_value) const;
+
+  // Calls updater(value) on the value of the key in place under the segment lock, inserting a
+  // value initialized one first if not found. Returns whether the key is inserted.
+  template <class Q, class F>
+  bool update(const Q& key, const size_t hash_value, const F& updater);
+
+  // May run concurrently with the writes, as get does. Only the prefetches go unsynchronized.
+  void get_many(
+      const K* keys,
+      const size_t* hash_values,
+      const size_t n,
+      V* values,
+      const V& default_value) const;
+
+  // Moves the entries into pending async_set reductions before it, re-segmenting first if the
+  // async_set contention calls for more segments, see set_max_contention.
+  void sync() { sync(Reducer<V>::overwrite); }
+
+  template <class R>
+  void sync(const R& reducer);
 
-  void async_set(
-      const K& key,
-      const size_t hash_value,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer);
+  // Moves all the entries into n_segments new segments. Not safe concurrently with any other
+  // operation. Entries pending in the thread caches stay there.
+  void set_n_segments(const size_t n_segments);
 
-  V get(const K& key, const size_t hash_value, const V& default_value) const;
+  template <class F>
+  void for_each(const F& handler) const;
 
-  void sync(const std::function<void(V&, const V&)>& reducer = Reducer<V>::overwrite);
+  template <class F>
+  void for_each_serial(const F& handler) const;
 
-  void for_each(const std::function<void(const K& key, const size_t hash_value, const V& value)>&
-                    handler) const;
+  // Copies the entries of all the segments into one immutable table without locks, see
+  // FrozenHashMap. Entries pending in the thread caches are not included, so call it after sync.
+  FrozenHashMap<K, V, H> freeze() const;
 
-  void for_each_serial(
-      const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler)
-      const;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::clear;
 
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::clear;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::get_n_keys;
 
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::get_max_load_factor;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::get_max_load_factor;
 
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::set_max_load_factor;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::set_max_load_factor;
 
   template <class B>
   void serialize(B& buf) const;
@@ -47,94 +86,167 @@ class ConcurrentHashMap : public ConcurrentHashBase<K, V, HashMap<K, V, H>, H> {
   void parse(B& buf);
 
  protected:
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::n_segments;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::n_segments;
 
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::segments;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::segments;
 
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::segment_locks;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::lock_segment;
 
-  using ConcurrentHashBase<K, V, HashMap<K, V, H>, H>::thread_caches;
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::try_lock_segment;
+
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::unlock_segment;
+
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::read_segment;
+
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::reset_segments;
+
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::get_adapted_n_segments;
+
+  using ConcurrentHashBase<K, V, MapSegment<K, V, H, A>, H, L>::thread_caches;
 };
 
-template <class K, class V, class H>
-void ConcurrentHashMap<K, V, H>::set(
-    const K& key,
-    const size_t hash_value,
-    const V& value,
-    const std::function<void(V&, const V&)>& reducer) {
+template <class K, class V, class H, template <class> class A, class L>
+template <class Q, class R>
+void ConcurrentHashMap<K, V, H, A, L>::set(
+    const Q& key, const size_t hash_value, const V& value, const R& reducer) {
   const size_t segment_id = hash_value % n_segments;
-  auto& lock = segment_locks[segment_id];
-  HashMap<K, V, H>* segment_ptr = &segments[segment_id];
-  omp_set_lock(&lock);
+  MapSegment<K, V, H, A>* segment_ptr = &segments[segment_id];
+  lock_segment(segment_id);
   segment_ptr->set(key, hash_value, value, reducer);
-  omp_unset_lock(&lock);
+  unlock_segment(segment_id);
 }
 
-template <class K, class V, class H>
-void ConcurrentHashMap<K, V, H>::async_set(
-    const K& key,
-    const size_t hash_value,
-    const V& value,
-    const std::function<void(V&, const V&)>& reducer) {
+template <class K, class V, class H, template <class> class A, class L>
+template <class Q, class R>
+void ConcurrentHashMap<K, V, H, A, L>::async_set(
+    const Q& key, const size_t hash_value, const V& value, const R& reducer) {
   const size_t segment_id = hash_value % n_segments;
-  auto& lock = segment_locks[segment_id];
-  HashMap<K, V, H>* segment_ptr = &segments[segment_id];
-  if (omp_test_lock(&lock)) {
+  MapSegment<K, V, H, A>* segment_ptr = &segments[segment_id];
+  if (try_lock_segment(segment_id)) {
     segment_ptr->set(key, hash_value, value, reducer);
-    omp_unset_lock(&lock);
+    unlock_segment(segment_id);
   } else {
     const int thread_id = omp_get_thread_num();
     thread_caches[thread_id].set(key, hash_value, value, reducer);
   }
 }
 
-template <class K, class V, class H>
-V ConcurrentHashMap<K, V, H>::get(
-    const K& key, const size_t hash_value, const V& default_value) const {
+template <class K, class V, class H, template <class> class A, class L>
+template <class Q>
+V ConcurrentHashMap<K, V, H, A, L>::get(
+    const Q& key, const size_t hash_value, const V& default_value) const {
+  return this->template read_segment<V>(
+      hash_value % n_segments, [&](const MapSegment<K, V, H, A>& segment) {
+        return segment.get(key, hash_value, default_value);
+      });
+}
+
+template <class K, class V, class H, template <class> class A, class L>
+template <class Q>
+const V* ConcurrentHashMap<K, V, H, A, L>::find(const Q& key, const size_t hash_value) const {
   const size_t segment_id = hash_value % n_segments;
-  V res = segments[segment_id].get(key, hash_value, default_value);
-  return res;
+  return segments[segment_id].find(key, hash_value);
 }
 
-template <class K, class V, class H>
-void ConcurrentHashMap<K, V, H>::sync(const std::function<void(V&, const V&)>& reducer) {
+template <class K, class V, class H, template <class> class A, class L>
+template <class Q, class F>
+bool ConcurrentHashMap<K, V, H, A, L>::update(
+    const Q& key, const size_t hash_value, const F& updater) {
+  const size_t segment_id = hash_value % n_segments;
+  lock_segment(segment_id);
+  const bool inserted = segments[segment_id].upsert(key, hash_value, updater, [&](V& value) {
+    value = V();
+    updater(value);
+  });
+  unlock_segment(segment_id);
+  return inserted;
+}
+
+template <class K, class V, class H, template <class> class A, class L>
+void ConcurrentHashMap<K, V, H, A, L>::get_many(
+    const K* keys,
+    const size_t* hash_values,
+    const size_t n,
+    V* values,
+    const V& default_value) const {
+  const size_t n_ahead = MapSegment<K, V, H, A>::N_PREFETCH_AHEAD;
+  for (size_t i = 0; i < n && i < n_ahead; i++) {
+    segments[hash_values[i] % n_segments].prefetch(hash_values[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (i + n_ahead < n) {
+      const size_t hash_value = hash_values[i + n_ahead];
+      segments[hash_value % n_segments].prefetch(hash_value);
+    }
+    values[i] = this->template read_segment<V>(
+        hash_values[i] % n_segments, [&](const MapSegment<K, V, H, A>& segment) {
+          return segment.get(keys[i], hash_values[i], default_value);
+        });
+  }
+}
+
+template <class K, class V, class H, template <class> class A, class L>
+template <class R>
+void ConcurrentHashMap<K, V, H, A, L>::sync(const R& reducer) {
+  const size_t n_adapted_segments = get_adapted_n_segments();
+  if (n_adapted_segments != n_segments) set_n_segments(n_adapted_segments);
 #pragma omp parallel
   {
     const int thread_id = omp_get_thread_num();
     const auto& handler = [&](const K& key, const size_t hash_value, const V& value) {
       const size_t segment_id = hash_value % n_segments;
-      auto& lock = segment_locks[segment_id];
-      omp_set_lock(&lock);
+      lock_segment(segment_id);
       segments.at(segment_id).set(key, hash_value, value, reducer);
-      omp_unset_lock(&lock);
+      unlock_segment(segment_id);
     };
     thread_caches.at(thread_id).for_each(handler);
     thread_caches.at(thread_id).clear();
   }
 }
 
-template <class K, class V, class H>
-void ConcurrentHashMap<K, V, H>::for_each(
-    const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler)
-    const {
+template <class K, class V, class H, template <class> class A, class L>
+void ConcurrentHashMap<K, V, H, A, L>::set_n_segments(const size_t n_segments) {
+  std::vector<MapSegment<K, V, H, A>> old_segments = reset_segments(n_segments, get_n_keys());
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t i = 0; i < old_segments.size(); i++) {
+    old_segments[i].for_each([&](const K& key, const size_t hash_value, const V& value) {
+      const size_t segment_id = hash_value % n_segments;
+      lock_segment(segment_id);
+      segments[segment_id].set(key, hash_value, value, Reducer<V>::overwrite);
+      unlock_segment(segment_id);
+    });
+    old_segments[i].clear_and_shrink();
+  }
+}
+
+template <class K, class V, class H, template <class> class A, class L>
+template <class F>
+void ConcurrentHashMap<K, V, H, A, L>::for_each(const F& handler) const {
 #pragma omp parallel for schedule(dynamic, 1)
   for (size_t segment_id = 0; segment_id < n_segments; segment_id++) {
     segments[segment_id].for_each(handler);
   }
 }
 
-template <class K, class V, class H>
-void ConcurrentHashMap<K, V, H>::for_each_serial(
-    const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler)
-    const {
+template <class K, class V, class H, template <class> class A, class L>
+template <class F>
+void ConcurrentHashMap<K, V, H, A, L>::for_each_serial(const F& handler) const {
   for (size_t segment_id = 0; segment_id < n_segments; segment_id++) {
     segments[segment_id].for_each(handler);
   }
 }
 
-template <class K, class V, class H>
+template <class K, class V, class H, template <class> class A, class L>
+FrozenHashMap<K, V, H> ConcurrentHashMap<K, V, H, A, L>::freeze() const {
+  return FrozenHashMap<K, V, H>(
+      get_n_keys(), [&](const typename FrozenHashMap<K, V, H>::EntryHandler& handler) {
+        for_each_serial(handler);
+      });
+}
+
+template <class K, class V, class H, template <class> class A, class L>
 template <class B>
-void ConcurrentHashMap<K, V, H>::serialize(B& buf) const {
+void ConcurrentHashMap<K, V, H, A, L>::serialize(B& buf) const {
   const float max_load_factor = get_max_load_factor();
   buf << n_segments << max_load_factor;
   for (size_t i = 0; i < n_segments; i++) {
@@ -142,15 +254,15 @@ void ConcurrentHashMap<K, V, H>::serialize(B& buf) const {
   }
 }
 
-template <class K, class V, class H>
+template <class K, class V, class H, template <class> class A, class L>
 template <class B>
-void ConcurrentHashMap<K, V, H>::parse(B& buf) {
+void ConcurrentHashMap<K, V, H, A, L>::parse(B& buf) {
   clear();
   size_t n_segments_buf;
   float max_load_factor;
   buf >> n_segments_buf >> max_load_factor;
   set_max_load_factor(max_load_factor);
-  HashMap<K, V, H> segment_buf;
+  MapSegment<K, V, H, A> segment_buf;
   const auto& handler = [&](const K& key, const size_t hash_value, const V& value) {
     set(key, hash_value, value, Reducer<V>::keep);
   };
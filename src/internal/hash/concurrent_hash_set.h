@@ -8,23 +8,39 @@ namespace fgpl {
 namespace internal {
 namespace hash {
 
-template <class K, class H = std::hash<K>>
-class ConcurrentHashSet : public ConcurrentHashBase<K, void, HashSet<K, H>, H> {
+// The segments and thread caches of concurrent sets.
+template <class K, class H, template <class> class A>
+using SetSegment = HashSet<K, H, PrimeCapacity, LinearProbing, A>;
+
+template <
+    class K,
+    class H = std::hash<K>,
+    template <class> class A = std::allocator,
+    class L = OmpLock>
+class ConcurrentHashSet : public ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L> {
  public:
   void set(const K& key, const size_t hash_value);
 
   void async_set(const K& key, const size_t hash_value);
 
+  // Re-segments first if the async_set contention calls for more segments, see
+  // set_max_contention.
   void sync();
 
-  void for_each_serial(
-      const std::function<void(const K& key, const size_t hash_value)>& handler) const;
+  // Moves all the entries into n_segments new segments. Not safe concurrently with any other
+  // operation. Entries pending in the thread caches stay there.
+  void set_n_segments(const size_t n_segments);
 
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::clear;
+  template <class F>
+  void for_each_serial(const F& handler) const;
 
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::get_max_load_factor;
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::clear;
 
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::set_max_load_factor;
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::get_n_keys;
+
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::get_max_load_factor;
+
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::set_max_load_factor;
 
   template <class B>
   void serialize(B& buf) const;
@@ -33,67 +49,89 @@ class ConcurrentHashSet : public ConcurrentHashBase<K, void, HashSet<K, H>, H> {
   void parse(B& buf);
 
  protected:
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::n_segments;
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::n_segments;
+
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::segments;
+
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::lock_segment;
+
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::try_lock_segment;
 
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::segments;
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::unlock_segment;
 
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::segment_locks;
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::thread_caches;
 
-  using ConcurrentHashBase<K, void, HashSet<K, H>, H>::thread_caches;
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::reset_segments;
+
+  using ConcurrentHashBase<K, void, SetSegment<K, H, A>, H, L>::get_adapted_n_segments;
 };
 
-template <class K, class H>
-void ConcurrentHashSet<K, H>::set(const K& key, const size_t hash_value) {
+template <class K, class H, template <class> class A, class L>
+void ConcurrentHashSet<K, H, A, L>::set(const K& key, const size_t hash_value) {
   const size_t segment_id = hash_value % n_segments;
-  auto& lock = segment_locks[segment_id];
-  HashSet<K, H>* segment_ptr = &segments[segment_id];
-  omp_set_lock(&lock);
+  SetSegment<K, H, A>* segment_ptr = &segments[segment_id];
+  lock_segment(segment_id);
   segment_ptr->set(key, hash_value);
-  omp_unset_lock(&lock);
+  unlock_segment(segment_id);
 }
 
-template <class K, class H>
-void ConcurrentHashSet<K, H>::async_set(const K& key, const size_t hash_value) {
+template <class K, class H, template <class> class A, class L>
+void ConcurrentHashSet<K, H, A, L>::async_set(const K& key, const size_t hash_value) {
   const size_t segment_id = hash_value % n_segments;
-  auto& lock = segment_locks[segment_id];
-  HashSet<K, H>* segment_ptr = &segments[segment_id];
-  if (omp_test_lock(&lock)) {
+  SetSegment<K, H, A>* segment_ptr = &segments[segment_id];
+  if (try_lock_segment(segment_id)) {
     segment_ptr->set(key, hash_value);
-    omp_unset_lock(&lock);
+    unlock_segment(segment_id);
   } else {
     const int thread_id = omp_get_thread_num();
     thread_caches[thread_id].set(key, hash_value);
   }
 }
 
-template <class K, class H>
-void ConcurrentHashSet<K, H>::sync() {
+template <class K, class H, template <class> class A, class L>
+void ConcurrentHashSet<K, H, A, L>::sync() {
+  const size_t n_adapted_segments = get_adapted_n_segments();
+  if (n_adapted_segments != n_segments) set_n_segments(n_adapted_segments);
 #pragma omp parallel
   {
     const int thread_id = omp_get_thread_num();
     const auto& handler = [&](const K& key, const size_t hash_value) {
       const size_t segment_id = hash_value % n_segments;
-      auto& lock = segment_locks[segment_id];
-      omp_set_lock(&lock);
+      lock_segment(segment_id);
       segments.at(segment_id).set(key, hash_value);
-      omp_unset_lock(&lock);
+      unlock_segment(segment_id);
     };
     thread_caches.at(thread_id).for_each(handler);
     thread_caches.at(thread_id).clear();
   }
 }
 
-template <class K, class H>
-void ConcurrentHashSet<K, H>::for_each_serial(
-    const std::function<void(const K& key, const size_t hash_value)>& handler) const {
+template <class K, class H, template <class> class A, class L>
+void ConcurrentHashSet<K, H, A, L>::set_n_segments(const size_t n_segments) {
+  std::vector<SetSegment<K, H, A>> old_segments = reset_segments(n_segments, get_n_keys());
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t i = 0; i < old_segments.size(); i++) {
+    old_segments[i].for_each([&](const K& key, const size_t hash_value) {
+      const size_t segment_id = hash_value % n_segments;
+      lock_segment(segment_id);
+      segments[segment_id].set(key, hash_value);
+      unlock_segment(segment_id);
+    });
+    old_segments[i].clear_and_shrink();
+  }
+}
+
+template <class K, class H, template <class> class A, class L>
+template <class F>
+void ConcurrentHashSet<K, H, A, L>::for_each_serial(const F& handler) const {
   for (size_t segment_id = 0; segment_id < n_segments; segment_id++) {
     segments[segment_id].for_each(handler);
   }
 }
 
-template <class K, class H>
+template <class K, class H, template <class> class A, class L>
 template <class B>
-void ConcurrentHashSet<K, H>::serialize(B& buf) const {
+void ConcurrentHashSet<K, H, A, L>::serialize(B& buf) const {
   const float max_load_factor = get_max_load_factor();
   buf << n_segments << max_load_factor;
   for (size_t i = 0; i < n_segments; i++) {
@@ -101,15 +139,15 @@ void ConcurrentHashSet<K, H>::serialize(B& buf) const {
   }
 }
 
-template <class K, class H>
+template <class K, class H, template <class> class A, class L>
 template <class B>
-void ConcurrentHashSet<K, H>::parse(B& buf) {
+void ConcurrentHashSet<K, H, A, L>::parse(B& buf) {
   clear();
   size_t n_segments_buf;
   float max_load_factor;
   buf >> n_segments_buf >> max_load_factor;
   set_max_load_factor(max_load_factor);
-  HashSet<K, H> segment_buf;
+  SetSegment<K, H, A> segment_buf;
   const auto& handler = [&](const K& key, const size_t hash_value) { set(key, hash_value); };
   for (size_t i = 0; i < n_segments_buf; i++) {
     buf >> segment_buf;
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// One byte of metadata per bucket: a 7-bit hash tag when filled, otherwise EMPTY or DELETED.
+class Ctrl {
+ public:
+  constexpr static uint8_t EMPTY = 0x80;
+
+  constexpr static uint8_t DELETED = 0xFE;
+
+  static uint8_t get_tag(const size_t hash_value) {
+    // Take the tag from a different mix than the bucket id so that neighbors rarely share tags.
+    return static_cast<uint8_t>((hash_value * 0xC2B2AE3D27D4EB4Full) >> 57);
+  }
+
+  static bool is_filled(const uint8_t ctrl) { return (ctrl & 0x80) == 0; }
+};
+
+// A window of consecutive control bytes matched against a tag all at once.
+class CtrlGroup {
+ public:
+  constexpr static size_t SIZE = 16;
+
+  explicit CtrlGroup(const uint8_t* ctrls);
+
+  // Bitmask of the positions whose tag equals the given one.
+  uint32_t match(const uint8_t tag) const;
+
+  uint32_t match_empty() const;
+
+  uint32_t match_filled() const;
+
+ private:
+#ifdef __SSE2__
+  __m128i ctrls;
+#else
+  uint8_t ctrls[SIZE];
+
+  uint32_t match_byte(const uint8_t byte) const;
+#endif
+};
+
+// Where probe_ctrl_groups ended.
+struct CtrlProbe {
+  // The bucket of the matching entry if found, otherwise the first empty bucket, the bucket where
+  // stop ended the probe, or n_buckets once all the buckets are probed.
+  size_t bucket_id;
+
+  // The number of buckets probed before bucket_id.
+  size_t n_probes;
+
+  bool found;
+};
+
+// Probes the buckets from home_bucket_id a CtrlGroup at a time, calling match(bucket_id) on the
+// buckets of the tag, until one matches or an empty bucket ends the probe sequence. ctrls must be
+// followed by a copy of their first CtrlGroup::SIZE - 1. After each group without empty buckets,
+// stop(last_bucket_id, n_probes) may end the probe at the last bucket of the group.
+template <class M, class S>
+CtrlProbe probe_ctrl_groups(
+    const uint8_t* ctrls,
+    const size_t n_buckets,
+    const size_t home_bucket_id,
+    const uint8_t tag,
+    const M& match,
+    const S& stop);
+
+template <class M>
+CtrlProbe probe_ctrl_groups(
+    const uint8_t* ctrls,
+    const size_t n_buckets,
+    const size_t home_bucket_id,
+    const uint8_t tag,
+    const M& match) {
+  return probe_ctrl_groups(
+      ctrls, n_buckets, home_bucket_id, tag, match, [](const size_t, const size_t) {
+        return false;
+      });
+}
+
+#ifdef __SSE2__
+inline CtrlGroup::CtrlGroup(const uint8_t* ctrls) {
+  this->ctrls = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrls));
+}
+
+inline uint32_t CtrlGroup::match(const uint8_t tag) const {
+  const __m128i tags = _mm_set1_epi8(static_cast<char>(tag));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, tags)));
+}
+
+inline uint32_t CtrlGroup::match_empty() const {
+  const __m128i empties = _mm_set1_epi8(static_cast<char>(Ctrl::EMPTY));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, empties)));
+}
+
+inline uint32_t CtrlGroup::match_filled() const {
+  return static_cast<uint32_t>(~_mm_movemask_epi8(ctrls)) & 0xFFFF;
+}
+#else
+inline CtrlGroup::CtrlGroup(const uint8_t* ctrls) {
+  for (size_t i = 0; i < SIZE; i++) this->ctrls[i] = ctrls[i];
+}
+
+inline uint32_t CtrlGroup::match_byte(const uint8_t byte) const {
+  uint32_t res = 0;
+  for (size_t i = 0; i < SIZE; i++) {
+    if (ctrls[i] == byte) res |= 1u << i;
+  }
+  return res;
+}
+
+inline uint32_t CtrlGroup::match(const uint8_t tag) const { return match_byte(tag); }
+
+inline uint32_t CtrlGroup::match_empty() const { return match_byte(Ctrl::EMPTY); }
+
+inline uint32_t CtrlGroup::match_filled() const {
+  uint32_t res = 0;
+  for (size_t i = 0; i < SIZE; i++) {
+    if (Ctrl::is_filled(ctrls[i])) res |= 1u << i;
+  }
+  return res;
+}
+#endif
+
+template <class M, class S>
+CtrlProbe probe_ctrl_groups(
+    const uint8_t* ctrls,
+    const size_t n_buckets,
+    const size_t home_bucket_id,
+    const uint8_t tag,
+    const M& match,
+    const S& stop) {
+  size_t group_id = home_bucket_id;
+  size_t n_probes = 0;
+  while (n_probes < n_buckets) {
+    const CtrlGroup group(ctrls + group_id);
+    const uint32_t empty_mask = group.match_empty();
+    uint32_t match_mask = group.match(tag);
+    // Buckets after the first empty one belong to other probe sequences.
+    if (empty_mask != 0) match_mask &= (empty_mask & -empty_mask) - 1;
+    while (match_mask != 0) {
+      const size_t offset = __builtin_ctz(match_mask);
+      size_t bucket_id = group_id + offset;
+      if (bucket_id >= n_buckets) bucket_id -= n_buckets;
+      if (match(bucket_id)) return {bucket_id, n_probes + offset, true};
+      match_mask &= match_mask - 1;
+    }
+    if (empty_mask != 0) {
+      const size_t offset = __builtin_ctz(empty_mask);
+      size_t bucket_id = group_id + offset;
+      if (bucket_id >= n_buckets) bucket_id -= n_buckets;
+      return {bucket_id, n_probes + offset, false};
+    }
+    size_t last_bucket_id = group_id + CtrlGroup::SIZE - 1;
+    if (last_bucket_id >= n_buckets) last_bucket_id -= n_buckets;
+    if (stop(last_bucket_id, n_probes + CtrlGroup::SIZE - 1)) {
+      return {last_bucket_id, n_probes + CtrlGroup::SIZE - 1, false};
+    }
+    n_probes += CtrlGroup::SIZE;
+    group_id += CtrlGroup::SIZE;
+    if (group_id >= n_buckets) group_id -= n_buckets;
+  }
+  return {n_buckets, n_probes, false};
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
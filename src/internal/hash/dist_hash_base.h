@@ -26,6 +26,18 @@ class DistHashBase {
 
   void set_max_load_factor(const float max_load_factor);
 
+  void set_min_load_factor(const float min_load_factor) {
+    local_data.set_min_load_factor(min_load_factor);
+  }
+
+  // Erases the local entries for which pred is true, see ConcurrentHashMap::erase_if. Collective,
+  // returns the number of entries erased on all the procs.
+  template <class F>
+  size_t erase_if(const F& pred);
+
+  template <class F>
+  size_t retain(const F& pred);
+
   void clear();
 
   void clear_and_shrink();
@@ -95,6 +107,36 @@ void DistHashBase<K, V, C, H>::set_max_load_factor(const float max_load_factor)
   for (auto& remote_map : remote_data) remote_map.set_max_load_factor(max_load_factor);
 }
 
+template <class K, class V, class C, class H>
+template <class F>
+size_t DistHashBase<K, V, C, H>::erase_if(const F& pred) {
+  const size_t local_n_erased_keys = local_data.erase_if(pred);
+  size_t n_erased_keys;
+  MPI_Allreduce(
+      &local_n_erased_keys,
+      &n_erased_keys,
+      1,
+      internal::MpiType<size_t>::value,
+      MPI_SUM,
+      MPI_COMM_WORLD);
+  return n_erased_keys;
+}
+
+template <class K, class V, class C, class H>
+template <class F>
+size_t DistHashBase<K, V, C, H>::retain(const F& pred) {
+  const size_t local_n_erased_keys = local_data.retain(pred);
+  size_t n_erased_keys;
+  MPI_Allreduce(
+      &local_n_erased_keys,
+      &n_erased_keys,
+      1,
+      internal::MpiType<size_t>::value,
+      MPI_SUM,
+      MPI_COMM_WORLD);
+  return n_erased_keys;
+}
+
 template <class K, class V, class C, class H>
 std::vector<int> DistHashBase<K, V, C, H>::generate_shuffled_procs() {
   std::vector<int> res(n_procs);
@@ -11,56 +11,56 @@ namespace fgpl {
 namespace internal {
 namespace hash {
 
-template <class K, class V, class H = std::hash<K>>
-class DistHashMap : public DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H> {
+template <class K, class V, class H = std::hash<K>, template <class> class A = std::allocator>
+class DistHashMap : public DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H> {
  public:
-  void async_set(
-      const K& key,
-      const size_t hash_value,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer);
+  // The key may be of any type Q the hasher accepts in place of K, see IsTransparentKey.
+  template <class Q, class R>
+  void async_set(const Q& key, const size_t hash_value, const V& value, const R& reducer);
 
-  void sync(const std::function<void(V&, const V&)>& reducer = Reducer<V>::overwrite);
+  void sync() { sync(Reducer<V>::overwrite); }
 
-  double get_local(const K& key, const size_t hash_value, const V& default_value) const;
+  template <class R>
+  void sync(const R& reducer);
 
-  void for_each(
-      const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler)
-      const;
+  V get_local(const K& key, const size_t hash_value, const V& default_value) const;
 
-  void for_each_serial(
-      const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler);
+  // Freezes the entries of this proc, which are looked up by the hash values of DistHasher.
+  FrozenHashMap<K, V, DistHasher<K, H>> freeze_local() const { return local_data.freeze(); }
 
-  template <class V2>
-  V2 mapreduce(
-      const std::function<V2(const K& key, const V& value)>& mapper,
-      const std::function<void(V2&, const V2&)>& reducer,
-      const V2& default_value);
+  template <class F>
+  void for_each(const F& handler) const;
+
+  template <class F>
+  void for_each_serial(const F& handler);
+
+  // Reduces mapper(key, value) of all the entries with reducer(V2&, const V2&).
+  template <class V2, class M, class R>
+  V2 mapreduce(const M& mapper, const R& reducer, const V2& default_value);
 
  private:
   DistHasher<K, H> dist_hasher;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::hasher;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::hasher;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::n_procs;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::n_procs;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::proc_id;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::proc_id;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::local_data;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::local_data;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::remote_data;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::remote_data;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::generate_shuffled_procs;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::
+      generate_shuffled_procs;
 
-  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>>, H>::get_shuffled_id;
+  using DistHashBase<K, V, ConcurrentHashMap<K, V, DistHasher<K, H>, A>, H>::get_shuffled_id;
 };
 
-template <class K, class V, class H>
-void DistHashMap<K, V, H>::async_set(
-    const K& key,
-    const size_t hash_value,
-    const V& value,
-    const std::function<void(V&, const V&)>& reducer) {
+template <class K, class V, class H, template <class> class A>
+template <class Q, class R>
+void DistHashMap<K, V, H, A>::async_set(
+    const Q& key, const size_t hash_value, const V& value, const R& reducer) {
   const size_t n_procs_u = n_procs;
   const size_t proc_id_u = proc_id;
   const size_t dest_proc_id = hash_value % n_procs_u;
@@ -72,8 +72,8 @@ void DistHashMap<K, V, H>::async_set(
   }
 }
 
-template <class K, class V, class H>
-double DistHashMap<K, V, H>::get_local(
+template <class K, class V, class H, template <class> class A>
+V DistHashMap<K, V, H, A>::get_local(
     const K& key, const size_t hash_value, const V& default_value) const {
   const size_t n_procs_u = n_procs;
   const size_t proc_id_u = proc_id;
@@ -86,8 +86,9 @@ double DistHashMap<K, V, H>::get_local(
   }
 }
 
-template <class K, class V, class H>
-void DistHashMap<K, V, H>::sync(const std::function<void(V&, const V&)>& reducer) {
+template <class K, class V, class H, template <class> class A>
+template <class R>
+void DistHashMap<K, V, H, A>::sync(const R& reducer) {
   const auto& node_handler = [&](const K& key, const size_t hash_value, const V& value) {
     local_data.set(key, hash_value, value, reducer);
   };
@@ -174,28 +175,24 @@ void DistHashMap<K, V, H>::sync(const std::function<void(V&, const V&)>& reducer
   local_data.sync(reducer);
 }
 
-template <class K, class V, class H>
-void DistHashMap<K, V, H>::for_each(
-    const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler)
-    const {
+template <class K, class V, class H, template <class> class A>
+template <class F>
+void DistHashMap<K, V, H, A>::for_each(const F& handler) const {
   local_data.for_each(handler);
 }
 
-template <class K, class V, class H>
-void DistHashMap<K, V, H>::for_each_serial(
-    const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler) {
+template <class K, class V, class H, template <class> class A>
+template <class F>
+void DistHashMap<K, V, H, A>::for_each_serial(const F& handler) {
   const auto& local_maps = gather(local_data);
   for (int i = 0; i < n_procs; i++) {
     local_maps[i].for_each_serial(handler);
   }
 }
 
-template <class K, class V, class H>
-template <class V2>
-V2 DistHashMap<K, V, H>::mapreduce(
-    const std::function<V2(const K& key, const V& value)>& mapper,
-    const std::function<void(V2&, const V2&)>& reducer,
-    const V2& default_value) {
+template <class K, class V, class H, template <class> class A>
+template <class V2, class M, class R>
+V2 DistHashMap<K, V, H, A>::mapreduce(const M& mapper, const R& reducer, const V2& default_value) {
   const int n_threads = omp_get_max_threads();
   std::vector<V2> res_thread(n_threads, default_value);
   for_each([&](const K& key, const size_t, const V& value) {
@@ -10,35 +10,37 @@ namespace fgpl {
 namespace internal {
 namespace hash {
 
-template <class K, class H = std::hash<K>>
-class DistHashSet : public DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H> {
+template <class K, class H = std::hash<K>, template <class> class A = std::allocator>
+class DistHashSet : public DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H> {
  public:
   void async_set(const K& key, const size_t hash_value);
 
   void sync();
 
-  void for_each_serial(const std::function<void(const K& key, const size_t hash_value)>& handler);
+  template <class F>
+  void for_each_serial(const F& handler);
 
  private:
   DistHasher<K, H> dist_hasher;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::hasher;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::hasher;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::n_procs;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::n_procs;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::proc_id;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::proc_id;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::local_data;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::local_data;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::remote_data;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::remote_data;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::generate_shuffled_procs;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::
+      generate_shuffled_procs;
 
-  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>>, H>::get_shuffled_id;
+  using DistHashBase<K, void, ConcurrentHashSet<K, DistHasher<K, H>, A>, H>::get_shuffled_id;
 };
 
-template <class K, class H>
-void DistHashSet<K, H>::async_set(const K& key, const size_t hash_value) {
+template <class K, class H, template <class> class A>
+void DistHashSet<K, H, A>::async_set(const K& key, const size_t hash_value) {
   const size_t n_procs_u = n_procs;
   const size_t proc_id_u = proc_id;
   const size_t dest_proc_id = hash_value % n_procs_u;
@@ -50,8 +52,8 @@ void DistHashSet<K, H>::async_set(const K& key, const size_t hash_value) {
   }
 }
 
-template <class K, class H>
-void DistHashSet<K, H>::sync() {
+template <class K, class H, template <class> class A>
+void DistHashSet<K, H, A>::sync() {
   const auto& node_handler = [&](const K& key, const size_t hash_value) {
     local_data.async_set(key, hash_value);
   };
@@ -139,9 +141,9 @@ void DistHashSet<K, H>::sync() {
   local_data.sync();
 }
 
-template <class K, class H>
-void DistHashSet<K, H>::for_each_serial(
-    const std::function<void(const K& key, const size_t hash_value)>& handler) {
+template <class K, class H, template <class> class A>
+template <class F>
+void DistHashSet<K, H, A>::for_each_serial(const F& handler) {
   const auto& local_sets = gather(local_data);
   for (int i = 0; i < n_procs; i++) {
     local_sets[i].for_each_serial(handler);
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include "../mpi_util.h"
+#include "hash_entry.h"
 
 namespace fgpl {
 namespace internal {
@@ -19,6 +20,18 @@ class DistHasher {
 
   size_t n_procs_u;
 };
+
+template <class K>
+class IsCompactKey<K, DistHasher<K, std::hash<K>>> {
+ public:
+  constexpr static bool value = std::is_integral<K>::value;
+};
+
+template <class K, class H>
+class IsArenaKey<K, DistHasher<K, H>> {
+ public:
+  constexpr static bool value = IsArenaKey<K, H>::value;
+};
 }  // namespace hash
 }  // namespace internal
 }  // namespace fgpl
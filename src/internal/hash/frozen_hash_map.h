@@ -0,0 +1,169 @@
+#pragma once
+
+#include <functional>
+#include <numeric>
+#include <vector>
+#include "capacity.h"
+#include "string_hasher.h"
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// An immutable hash map packed into an array of entries sorted by bucket, with each bucket given
+// by its offset into the array. There are no empty buckets, hash values or locks to store, and
+// lookups from any number of threads need no synchronization.
+template <class K, class V, class H = std::hash<K>>
+class FrozenHashMap {
+ public:
+  // Takes the entries passed to the build, counting them by bucket in the first pass and placing
+  // them in the second.
+  class EntryHandler {
+   public:
+    void operator()(const K& key, const size_t hash_value, const V& value) const;
+
+   private:
+    friend class FrozenHashMap;
+
+    FrozenHashMap* m;
+
+    // The next entry of each bucket, or nullptr while counting.
+    std::vector<size_t>* next_entry_ids;
+
+    EntryHandler(FrozenHashMap* m, std::vector<size_t>* next_entry_ids)
+        : m(m), next_entry_ids(next_entry_ids) {}
+  };
+
+  // Average number of entries per bucket, which are contiguous so scanning them is cheap.
+  constexpr static size_t N_KEYS_PER_BUCKET = 2;
+
+  FrozenHashMap();
+
+  // Builds from the n_keys entries for_each_entry(const EntryHandler&) passes to the handler. It
+  // is called twice, and must give the same entries with the hash values of H both times.
+  template <class F>
+  FrozenHashMap(const size_t n_keys, const F& for_each_entry);
+
+  size_t get_n_keys() const { return entries.size(); }
+
+  size_t get_n_buckets() const { return n_buckets; }
+
+  // Bytes of the offsets and entries.
+  size_t get_n_bytes() const {
+    return offsets.size() * sizeof(size_t) + entries.size() * sizeof(Entry);
+  }
+
+  // The key may be of any type Q comparable to K whose hash values match, see IsTransparentKey.
+  template <class Q>
+  V get(const Q& key, const size_t hash_value, const V& default_value) const;
+
+  template <class Q>
+  bool has(const Q& key, const size_t hash_value) const;
+
+  // Returns the value of the key in place, or nullptr if not found.
+  template <class Q>
+  const V* find(const Q& key, const size_t hash_value) const;
+
+  template <class F>
+  void for_each(const F& handler) const;
+
+ protected:
+  struct Entry {
+    K key;
+
+    V value;
+  };
+
+  size_t n_buckets;
+
+  // Entries of bucket i are from offsets[i] to offsets[i + 1].
+  std::vector<size_t> offsets;
+
+  std::vector<Entry> entries;
+
+  PowerOfTwoCapacity capacity;
+
+  H hasher;
+
+  template <class Q>
+  const Entry* find_entry(const Q& key, const size_t hash_value) const;
+};
+
+template <class K, class V, class H>
+FrozenHashMap<K, V, H>::FrozenHashMap() {
+  n_buckets = PowerOfTwoCapacity::N_INITIAL_BUCKETS;
+  capacity.set_n_buckets(n_buckets);
+  offsets.assign(n_buckets + 1, 0);
+}
+
+template <class K, class V, class H>
+template <class F>
+FrozenHashMap<K, V, H>::FrozenHashMap(const size_t n_keys, const F& for_each_entry) {
+  n_buckets = PowerOfTwoCapacity::get_n_buckets(n_keys / N_KEYS_PER_BUCKET);
+  capacity.set_n_buckets(n_buckets);
+
+  // Counting sort of the entries by bucket.
+  offsets.assign(n_buckets + 1, 0);
+  for_each_entry(EntryHandler(this, nullptr));
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<size_t> next_entry_ids(offsets.begin(), offsets.end() - 1);
+  entries.resize(offsets.back());
+  for_each_entry(EntryHandler(this, &next_entry_ids));
+}
+
+template <class K, class V, class H>
+void FrozenHashMap<K, V, H>::EntryHandler::operator()(
+    const K& key, const size_t hash_value, const V& value) const {
+  const size_t bucket_id = m->capacity.get_bucket_id(hash_value);
+  if (next_entry_ids == nullptr) {
+    m->offsets[bucket_id + 1]++;
+    return;
+  }
+  Entry& entry = m->entries[(*next_entry_ids)[bucket_id]++];
+  entry.key = key;
+  entry.value = value;
+}
+
+template <class K, class V, class H>
+template <class Q>
+V FrozenHashMap<K, V, H>::get(const Q& key, const size_t hash_value, const V& default_value) const {
+  const Entry* entry = find_entry(key, hash_value);
+  if (entry == nullptr) return default_value;
+  return entry->value;
+}
+
+template <class K, class V, class H>
+template <class Q>
+bool FrozenHashMap<K, V, H>::has(const Q& key, const size_t hash_value) const {
+  return find_entry(key, hash_value) != nullptr;
+}
+
+template <class K, class V, class H>
+template <class Q>
+const V* FrozenHashMap<K, V, H>::find(const Q& key, const size_t hash_value) const {
+  const Entry* entry = find_entry(key, hash_value);
+  if (entry == nullptr) return nullptr;
+  return &entry->value;
+}
+
+template <class K, class V, class H>
+template <class F>
+void FrozenHashMap<K, V, H>::for_each(const F& handler) const {
+  for (const Entry& entry : entries) handler(entry.key, hasher(entry.key), entry.value);
+}
+
+template <class K, class V, class H>
+template <class Q>
+const typename FrozenHashMap<K, V, H>::Entry* FrozenHashMap<K, V, H>::find_entry(
+    const Q& key, const size_t hash_value) const {
+  const size_t bucket_id = capacity.get_bucket_id(hash_value);
+  const size_t end_entry_id = offsets[bucket_id + 1];
+  for (size_t i = offsets[bucket_id]; i < end_entry_id; i++) {
+    if (entries[i].key == key) return &entries[i];
+  }
+  return nullptr;
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
@@ -1,208 +1,877 @@
 #pragma once
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
 #include <vector>
+#include "capacity.h"
+#include "ctrl_group.h"
 #include "hash_entry.h"
+#include "probing.h"
 
 namespace fgpl {
 namespace internal {
 namespace hash {
 
+// Counters of the probe lengths and the rehashes of a table.
+class HashStats {
+ public:
+  size_t max_n_probes;
+
+  size_t n_rehashes;
+
+  size_t n_reseeds;
+
+  HashStats() : max_n_probes(0), n_rehashes(0), n_reseeds(0) {}
+
+  void merge(const HashStats& other);
+};
+
+// Number of keys hashed at a time into a stack buffer by the batched calls.
+constexpr size_t N_HASH_CHUNK_KEYS = 256;
+
+// Calls handler(begin, hash_values, n_chunk_keys) for the keys N_HASH_CHUNK_KEYS at a time, where
+// hash_values holds the hash values of keys[begin] to keys[begin + n_chunk_keys - 1], so that
+// batches of any size hash their keys without a heap allocation.
+template <class K, class H, class F>
+void for_each_hash_chunk(const H& hasher, const K* keys, const size_t n, const F& handler) {
+  size_t hash_values[N_HASH_CHUNK_KEYS];
+  for (size_t begin = 0; begin < n; begin += N_HASH_CHUNK_KEYS) {
+    const size_t n_chunk_keys = std::min(N_HASH_CHUNK_KEYS, n - begin);
+    for (size_t i = 0; i < n_chunk_keys; i++) hash_values[i] = hasher(keys[begin + i]);
+    handler(begin, static_cast<const size_t*>(hash_values), n_chunk_keys);
+  }
+}
+
 // A linear probing hash container base.
-template <class K, class V, class H = std::hash<K>>
+// Each bucket has a control byte stored in a separate array, so that probing scans
+// CtrlGroup::SIZE buckets at a time and only touches the entries whose hash tags match.
+// The capacity policy C decides the bucket counts and maps hash values to buckets.
+// The probing policy P decides where new keys go within their runs.
+// The allocator A backs the bucket and control byte arrays, see HugePageAllocator and
+// PoolAllocator.
+// Long probes on a sparse table mean clustered hash values rather than a high load, so instead of
+// growing, the table rehashes with a new seed scrambled into the bucket ids.
+// With incremental_rehash set, a rehash keeps the old table and each write migrates a bounded
+// number of its buckets, so no single write pays for moving the whole table.
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing,
+    template <class> class A = std::allocator>
 class HashBase {
  public:
-  constexpr static float DEFAULT_MAX_LOAD_FACTOR = 0.7;
+  constexpr static float DEFAULT_MAX_LOAD_FACTOR = P::DEFAULT_MAX_LOAD_FACTOR;
 
-  constexpr static size_t N_INITIAL_BUCKETS = 13;
+  // At least CtrlGroup::SIZE so that a group never wraps around the table more than once.
+  constexpr static size_t N_INITIAL_BUCKETS = C::N_INITIAL_BUCKETS;
 
   constexpr static size_t MAX_N_PROBES = 64;
 
+  // Number of keys whose buckets are prefetched ahead of the one being looked up in batches.
+  constexpr static size_t N_PREFETCH_AHEAD = 8;
+
+  // Number of old buckets migrated per write during an incremental rehash. Growing by 1.3x takes
+  // about n_buckets / 5 inserts at the default load factors, so this finishes well before that.
+  constexpr static size_t N_MIGRATE_BUCKETS = 16;
+
+  // Tables from this size rehash with all the threads when not already in a parallel region.
+  constexpr static size_t N_PARALLEL_REHASH_BUCKETS_MIN = 1 << 16;
+
   float max_load_factor;
 
+  bool incremental_rehash;
+
+  // Erasing in bulk shrinks the table to fit once the load factor falls below this. 0 never
+  // shrinks.
+  float min_load_factor;
+
+  // Called with the stats after each reseed, from the write that triggered it. When empty, the
+  // first reseed prints a warning instead.
+  std::function<void(const HashStats& stats)> unbalanced_handler;
+
+  // Called before the bucket arrays are replaced or freed, from the write doing it, e.g. to wait
+  // for the readers that do not take the lock of a concurrent container.
+  std::function<void()> reallocate_handler;
+
   HashBase();
 
   size_t get_n_keys() const { return n_keys; }
 
   size_t get_n_buckets() const { return n_buckets; }
 
+  // Bytes of the keys stored outside the buckets, such as in the arena of string keys.
+  size_t get_n_key_bytes() const { return key_store.get_n_bytes(); }
+
   void reserve(const size_t n_keys_min);
 
   void reserve_n_buckets(const size_t n_buckets_min);
 
   void unset(const K& key, const size_t hash_value);
 
-  bool has(const K& key, const size_t hash_value) const;
+  // The key may be of any type Q the hasher accepts in place of K, see IsTransparentKey.
+  template <class Q>
+  bool has(const Q& key, const size_t hash_value) const;
+
+  void has_many(const K* keys, const size_t* hash_values, const size_t n, bool* res) const;
+
+  // Hints the cache to load the home bucket of the hash value ahead of a lookup.
+  void prefetch(const size_t hash_value) const;
 
   void clear();
 
   void clear_and_shrink();
 
+  // Rehashes into the fewest buckets that hold the keys within the max load factor, and drops the
+  // stored bytes of the erased keys.
+  void shrink_to_fit();
+
+  bool is_rehashing() const { return n_old_buckets > 0; }
+
+  // Migrates all the remaining entries of an incremental rehash at once.
+  void complete_rehash();
+
+  const HashStats& get_stats() const { return stats; }
+
+  size_t get_seed() const { return seed; }
+
+  // Rehashes the table with the bucket ids scrambled by the seed. 0 uses the hash values as is.
+  void set_seed(const size_t seed);
+
+  // A forward iterator over the filled buckets of both tables. Writes to the table invalidate it.
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+
+    using value_type = Iterator;
+
+    using difference_type = std::ptrdiff_t;
+
+    using pointer = const Iterator*;
+
+    using reference = const Iterator&;
+
+    Iterator() : base(nullptr), position(0) {}
+
+    Iterator(const HashBase* base, const size_t position) : base(base), position(position) {
+      skip_unfilled();
+    }
+
+    // Each element is the iterator itself, which reads the key and value of the current entry.
+    const Iterator& operator*() const { return *this; }
+
+    const Iterator* operator->() const { return this; }
+
+    Iterator& operator++() {
+      position++;
+      skip_unfilled();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    bool operator==(const Iterator& other) const { return position == other.position; }
+
+    bool operator!=(const Iterator& other) const { return position != other.position; }
+
+    // Keys stored in the arena are materialized into a buffer of the iterator.
+    const K& get_key() const { return get_entry().get_key(base->key_store, key_buf); }
+
+    size_t get_hash_value() const { return get_entry().get_hash_value(base->hasher); }
+
+    template <class VV = V>
+    const VV& get_value() const {
+      return get_entry().value;
+    }
+
+    const HashEntry<K, V, H>& get_entry() const {
+      if (position < base->n_buckets) return base->buckets[position];
+      return base->old_buckets[position - base->n_buckets];
+    }
+
+   private:
+    const HashBase* base;
+
+    // Buckets of the new table, followed by the ones of the old table.
+    size_t position;
+
+    mutable K key_buf;
+
+    void skip_unfilled();
+  };
+
+  Iterator begin() const { return Iterator(this, n_keys == 0 ? get_end_position() : 0); }
+
+  Iterator end() const { return Iterator(this, get_end_position()); }
+
  protected:
+  using Buckets = std::vector<HashEntry<K, V, H>, A<HashEntry<K, V, H>>>;
+
+  using Ctrls = std::vector<uint8_t, A<uint8_t>>;
+
   size_t n_keys;
 
   size_t n_buckets;
 
-  std::vector<HashEntry<K, V>> buckets;
+  Buckets buckets;
+
+  // Control bytes of the buckets, followed by a copy of the first CtrlGroup::SIZE - 1 of them
+  // so that a group can be loaded from any bucket without wrapping around.
+  Ctrls ctrls;
+
+  C capacity;
+
+  // Holds the bytes of the keys for the entries that do not store them inline.
+  typename HashEntry<K, V, H>::Store key_store;
+
+  // Recomputes the hash values of compact entries, which requires the hash values given to be
+  // the ones of this hasher.
+  H hasher;
 
   void check_balance(const size_t n_probes);
 
+  // Returns the bucket of the key if found, otherwise the bucket where the probe stopped,
+  // which is the first empty one for linear probing, or n_buckets when there is none.
+  template <class Q>
+  size_t find_bucket(const Q& key, const size_t hash_value, bool& found, size_t& n_probes) const;
+
+  // Returns the bucket to fill with a new key whose probe stopped at the given bucket.
+  // Robin Hood probing shifts the richer entries of the run to make room for it.
+  size_t insert_bucket(const size_t hash_value, const size_t bucket_id);
+
+  void set_ctrl(const size_t bucket_id, const uint8_t ctrl);
+
+  // Returns the entry of the key in either table, or nullptr if not found.
+  template <class Q>
+  const HashEntry<K, V, H>* find_entry(const Q& key, const size_t hash_value) const;
+
+  // Returns the entry of the key in the table being migrated from, or nullptr if not found.
+  template <class Q>
+  HashEntry<K, V, H>* find_old_entry(const Q& key, const size_t hash_value);
+
+  // Advances the incremental rehash. Called at the start of each write.
+  void migrate() {
+    if (n_old_buckets > 0) migrate_buckets(N_MIGRATE_BUCKETS);
+  }
+
+  // Calls handler(entry) on each entry of both tables.
+  template <class F>
+  void for_each_entry(const F& handler) const;
+
+  // Erases the entries for which pred(entry) is true in a single pass over the table, then shrinks
+  // the table if below min_load_factor. Returns the number of entries erased.
+  template <class F>
+  size_t erase_entries_if(const F& pred);
+
+  // Re-appends the keys of the table into a fresh key store, which drops the bytes of the erased
+  // keys.
+  void compact_key_store() {
+    compact_key_store(std::integral_constant<bool, IsArenaKey<K, H>::value>());
+  }
+
+  void compact_key_store(std::false_type) {}
+
+  void compact_key_store(std::true_type);
+
+  // Calls handler(i) for i from 0 to n - 1, with the buckets of the later hash values prefetched.
+  template <class F>
+  void for_each_prefetched(const size_t* hash_values, const size_t n, const F& handler) const;
+
+  // Calls handler(i, hash_value) for i from 0 to n - 1, hashing the keys N_HASH_CHUNK_KEYS at a
+  // time and prefetching their buckets as for_each_prefetched does.
+  template <class F>
+  void for_each_hashed(const K* keys, const size_t n, const F& handler) const;
+
  private:
   bool unbalanced_warned;
 
-  size_t get_n_rehash_buckets(const size_t n_buckets_min);
+  HashStats stats;
+
+  size_t seed;
+
+  // Number of keys at the last reseed. Reseeding again before the keys double suggests that the
+  // hash values themselves collide, which no seed spreads out.
+  size_t n_reseed_keys;
+
+  // The table being migrated from during an incremental rehash, where migrated and unset entries
+  // are marked DELETED so that the probes keep going past them. n_old_buckets is 0 otherwise.
+  size_t n_old_buckets;
+
+  Buckets old_buckets;
+
+  Ctrls old_ctrls;
+
+  C old_capacity;
+
+  size_t n_migrated_buckets;
+
+  void init_buckets(const size_t n_buckets);
+
+  // Returns the first empty bucket from the given one. Requires at least one empty bucket.
+  size_t find_empty_bucket(const size_t bucket_id) const;
+
+  // Number of buckets between the entry and its home bucket.
+  size_t get_probe_distance(const size_t bucket_id) const;
+
+  size_t next_bucket_id(const size_t bucket_id) const {
+    return bucket_id + 1 == n_buckets ? 0 : bucket_id + 1;
+  }
+
+  // Empties the filled bucket of the new table and shifts the later entries of its run back into
+  // the gap.
+  void erase_bucket(size_t bucket_id);
 
   void rehash(const size_t n_rehash_buckets);
+
+  void migrate_buckets(const size_t n_migrate_buckets);
+
+  void migrate_bucket(const size_t old_bucket_id);
+
+#ifdef _OPENMP
+  // Migrates the whole old table in parallel. The new table is cut into regions, each filled by
+  // one thread with the entries whose home buckets lie in it. The entries whose probes would run
+  // past the end of their regions are inserted serially afterwards, which also handles the runs
+  // that wrap around the end of the table.
+  void migrate_parallel(const size_t n_threads);
+#endif
+
+  // Returns the bucket of the key in the old table, or n_old_buckets if not found.
+  template <class Q>
+  size_t find_old_bucket(const Q& key, const size_t hash_value) const;
+
+  void set_old_ctrl(const size_t bucket_id, const uint8_t ctrl);
+
+  void clear_old_buckets();
+
+  size_t get_end_position() const { return n_buckets + n_old_buckets; }
+
+  // Returns the first filled bucket from the given one, or n if there is none.
+  static size_t find_filled_bucket(const uint8_t* ctrls, const size_t n, size_t bucket_id);
 };
 
-template <class K, class V, class H>
-HashBase<K, V, H>::HashBase() {
+template <class K, class V, class H, class C, class P, template <class> class A>
+HashBase<K, V, H, C, P, A>::HashBase() {
   n_keys = 0;
-  n_buckets = N_INITIAL_BUCKETS;
-  buckets.resize(N_INITIAL_BUCKETS);
+  seed = 0;
+  n_reseed_keys = 0;
+  init_buckets(N_INITIAL_BUCKETS);
   max_load_factor = DEFAULT_MAX_LOAD_FACTOR;
+  incremental_rehash = false;
+  min_load_factor = 0.0f;
   unbalanced_warned = false;
+  n_old_buckets = 0;
+  n_migrated_buckets = 0;
 }
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::reserve(const size_t n_keys_min) {
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::reserve(const size_t n_keys_min) {
   reserve_n_buckets(n_keys_min / max_load_factor);
 }
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::reserve_n_buckets(const size_t n_buckets_min) {
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::reserve_n_buckets(const size_t n_buckets_min) {
   if (n_buckets_min <= n_buckets) return;
-  const size_t n_rehash_buckets = get_n_rehash_buckets(n_buckets_min);
+  const size_t n_rehash_buckets = C::get_n_buckets(n_buckets_min);
   rehash(n_rehash_buckets);
 }
 
-template <class K, class V, class H>
-size_t HashBase<K, V, H>::get_n_rehash_buckets(const size_t n_buckets_min) {
-  constexpr size_t PRIMES[] = {
-      13, 17, 23, 29, 37, 47, 61, 79, 101, 127, 163, 211, 271, 337, 439, 547, 709, 887, 1153, 1433,
-      1861, 2311, 3001, 3739, 4861, 6053, 7867, 9791, 12721, 15859, 20611, 26783, 34841};
-  constexpr size_t N_PRIMES = sizeof(PRIMES) / sizeof(size_t);
-  constexpr size_t LAST_PRIME = PRIMES[N_PRIMES - 1];
-  constexpr size_t BIG_PRIME = PRIMES[N_PRIMES - 10];
-  size_t remaining_factor = n_buckets_min + n_buckets_min / 8;
-  size_t n_rehash_buckets = 1;
-  while (remaining_factor > LAST_PRIME) {
-    remaining_factor /= BIG_PRIME;
-    n_rehash_buckets *= BIG_PRIME;
-  }
-
-  // Find a prime larger than or equal to the remaining factor with binary search.
-  size_t left = 0, right = N_PRIMES - 1;
-  while (left < right) {
-    size_t mid = (left + right) / 2;
-    if (PRIMES[mid] < remaining_factor) {
-      left = mid + 1;
-    } else {
-      right = mid;
-    }
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::set_seed(const size_t seed) {
+  this->seed = seed;
+  rehash(n_buckets);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::init_buckets(const size_t n_buckets) {
+  this->n_buckets = n_buckets;
+  capacity.set_n_buckets(n_buckets);
+  capacity.set_seed(seed);
+  buckets.resize(n_buckets);
+  ctrls.assign(n_buckets + CtrlGroup::SIZE - 1, static_cast<uint8_t>(Ctrl::EMPTY));
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+size_t HashBase<K, V, H, C, P, A>::find_empty_bucket(const size_t bucket_id) const {
+  size_t group_id = bucket_id;
+  uint32_t empty_mask = CtrlGroup(&ctrls[group_id]).match_empty();
+  while (empty_mask == 0) {
+    group_id += CtrlGroup::SIZE;
+    if (group_id >= n_buckets) group_id -= n_buckets;
+    empty_mask = CtrlGroup(&ctrls[group_id]).match_empty();
   }
-  n_rehash_buckets *= PRIMES[left];
-  return n_rehash_buckets;
+  size_t empty_bucket_id = group_id + __builtin_ctz(empty_mask);
+  if (empty_bucket_id >= n_buckets) empty_bucket_id -= n_buckets;
+  return empty_bucket_id;
 }
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::rehash(const size_t n_rehash_buckets) {
-  std::vector<HashEntry<K, V>> rehash_buckets(n_rehash_buckets);
-  for (size_t i = 0; i < n_buckets; i++) {
-    if (!buckets.at(i).filled) continue;
-    const size_t hash_value = buckets.at(i).hash_value;
-    size_t rehash_bucket_id = hash_value % n_rehash_buckets;
-    size_t n_probes = 0;
-    while (n_probes < n_rehash_buckets) {
-      if (!rehash_buckets.at(rehash_bucket_id).filled) {
-        rehash_buckets.at(rehash_bucket_id) = buckets.at(i);
-        break;
-      } else {
-        n_probes++;
-        rehash_bucket_id = (rehash_bucket_id + 1) % n_rehash_buckets;
+template <class K, class V, class H, class C, class P, template <class> class A>
+size_t HashBase<K, V, H, C, P, A>::get_probe_distance(const size_t bucket_id) const {
+  const size_t home_bucket_id = capacity.get_bucket_id(buckets[bucket_id].get_hash_value(hasher));
+  if (bucket_id >= home_bucket_id) return bucket_id - home_bucket_id;
+  return bucket_id + n_buckets - home_bucket_id;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::rehash(const size_t n_rehash_buckets) {
+  if (reallocate_handler) reallocate_handler();
+  complete_rehash();
+  stats.n_rehashes++;
+  old_buckets.swap(buckets);
+  old_ctrls.swap(ctrls);
+  n_old_buckets = n_buckets;
+  old_capacity = capacity;
+  n_migrated_buckets = 0;
+  init_buckets(n_rehash_buckets);
+  if (!incremental_rehash || n_keys == 0) complete_rehash();
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::complete_rehash() {
+  if (n_old_buckets == 0) return;
+#ifdef _OPENMP
+  if (n_migrated_buckets == 0 && n_old_buckets >= N_PARALLEL_REHASH_BUCKETS_MIN &&
+      !omp_in_parallel() && omp_get_max_threads() > 1) {
+    migrate_parallel(omp_get_max_threads());
+    return;
+  }
+#endif
+  migrate_buckets(n_old_buckets - n_migrated_buckets);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::migrate_buckets(const size_t n_migrate_buckets) {
+  size_t end_bucket_id = n_migrated_buckets + n_migrate_buckets;
+  if (end_bucket_id > n_old_buckets) end_bucket_id = n_old_buckets;
+  for (size_t i = n_migrated_buckets; i < end_bucket_id; i++) {
+    if (Ctrl::is_filled(old_ctrls[i])) migrate_bucket(i);
+  }
+  n_migrated_buckets = end_bucket_id;
+  if (n_migrated_buckets == n_old_buckets) clear_old_buckets();
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::migrate_bucket(const size_t old_bucket_id) {
+  const size_t hash_value = old_buckets[old_bucket_id].get_hash_value(hasher);
+  size_t bucket_id;
+  if (P::ROBIN_HOOD) {
+    bucket_id = insert_bucket(hash_value, n_buckets);
+  } else {
+    bucket_id = find_empty_bucket(capacity.get_bucket_id(hash_value));
+  }
+  buckets[bucket_id] = std::move(old_buckets[old_bucket_id]);
+  set_ctrl(bucket_id, old_ctrls[old_bucket_id]);
+  set_old_ctrl(old_bucket_id, Ctrl::DELETED);
+}
+
+#ifdef _OPENMP
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::migrate_parallel(const size_t n_threads) {
+  const size_t n_regions = n_threads * 8;
+  const size_t n_region_buckets = (n_buckets + n_regions - 1) / n_regions;
+  const auto& get_region_id = [&](const size_t old_bucket_id) {
+    const size_t hash_value = old_buckets[old_bucket_id].get_hash_value(hasher);
+    return capacity.get_bucket_id(hash_value) / n_region_buckets;
+  };
+
+  // Group the old buckets by the regions of their new home buckets with a counting sort, where
+  // each thread handles a contiguous range of the old table. The team may have fewer than
+  // n_threads threads, e.g. under OMP_DYNAMIC or OMP_THREAD_LIMIT, so the ranges follow its size.
+  std::vector<size_t> offsets;
+  std::vector<size_t> old_bucket_ids(n_keys);
+  size_t n_team_threads = 0;
+#pragma omp parallel num_threads(n_threads)
+  {
+#pragma omp single
+    {
+      n_team_threads = omp_get_num_threads();
+      offsets.assign(n_regions * n_team_threads + 1, 0);
+    }
+    const size_t thread_id = omp_get_thread_num();
+    const size_t begin = n_old_buckets * thread_id / n_team_threads;
+    const size_t end = n_old_buckets * (thread_id + 1) / n_team_threads;
+    for (size_t i = begin; i < end; i++) {
+      if (Ctrl::is_filled(old_ctrls[i])) {
+        offsets[get_region_id(i) * n_team_threads + thread_id + 1]++;
       }
     }
+#pragma omp barrier
+#pragma omp single
+    for (size_t i = 1; i <= n_regions * n_team_threads; i++) offsets[i] += offsets[i - 1];
+    std::vector<size_t> positions(n_regions);
+    for (size_t r = 0; r < n_regions; r++) {
+      positions[r] = offsets[r * n_team_threads + thread_id];
+    }
+    for (size_t i = begin; i < end; i++) {
+      if (Ctrl::is_filled(old_ctrls[i])) old_bucket_ids[positions[get_region_id(i)]++] = i;
+    }
   }
-  buckets = std::move(rehash_buckets);
-  n_buckets = n_rehash_buckets;
-}
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::check_balance(const size_t n_probes) {
-  if (n_probes > MAX_N_PROBES) {
-    if (n_keys < n_buckets / 4 && !unbalanced_warned) {
-      fprintf(stderr, "Warning: Hash container is unbalanced!\n");
-      unbalanced_warned = true;
+  // Fill the regions. Robin Hood runs must stay sorted by home bucket, so those entries are
+  // placed in the order of their home buckets.
+  std::vector<std::vector<size_t>> overflows(n_regions);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(n_threads)
+  for (size_t r = 0; r < n_regions; r++) {
+    const size_t region_end = std::min((r + 1) * n_region_buckets, n_buckets);
+    std::vector<std::pair<size_t, size_t>> homes;
+    for (size_t j = offsets[r * n_team_threads]; j < offsets[(r + 1) * n_team_threads]; j++) {
+      const size_t i = old_bucket_ids[j];
+      homes.push_back(std::make_pair(
+          capacity.get_bucket_id(old_buckets[i].get_hash_value(hasher)), i));
     }
-    if (n_keys < n_buckets / 16) {
-      throw std::runtime_error("Hash container is severely unbalanced.");
+    if (P::ROBIN_HOOD) std::sort(homes.begin(), homes.end());
+    for (const auto& home : homes) {
+      size_t bucket_id = home.first;
+      while (bucket_id < region_end && Ctrl::is_filled(ctrls[bucket_id])) bucket_id++;
+      if (bucket_id == region_end) {
+        overflows[r].push_back(home.second);
+        continue;
+      }
+      buckets[bucket_id] = std::move(old_buckets[home.second]);
+      set_ctrl(bucket_id, old_ctrls[home.second]);
     }
+  }
+
+  for (const auto& region_overflows : overflows) {
+    for (const size_t i : region_overflows) migrate_bucket(i);
+  }
+  clear_old_buckets();
+}
+#endif
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+size_t HashBase<K, V, H, C, P, A>::find_old_bucket(const Q& key, const size_t hash_value) const {
+  const CtrlProbe probe = probe_ctrl_groups(
+      old_ctrls.data(),
+      n_old_buckets,
+      old_capacity.get_bucket_id(hash_value),
+      Ctrl::get_tag(hash_value),
+      [&](const size_t bucket_id) {
+        return old_buckets[bucket_id].key_equals(key, hash_value, key_store);
+      });
+  return probe.found ? probe.bucket_id : n_old_buckets;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::set_old_ctrl(const size_t bucket_id, const uint8_t ctrl) {
+  old_ctrls[bucket_id] = ctrl;
+  if (bucket_id < CtrlGroup::SIZE - 1) old_ctrls[n_old_buckets + bucket_id] = ctrl;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::clear_old_buckets() {
+  if (reallocate_handler && !old_ctrls.empty()) reallocate_handler();
+  Buckets().swap(old_buckets);
+  Ctrls().swap(old_ctrls);
+  n_old_buckets = 0;
+  n_migrated_buckets = 0;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+const HashEntry<K, V, H>* HashBase<K, V, H, C, P, A>::find_entry(
+    const Q& key, const size_t hash_value) const {
+  bool found;
+  size_t n_probes;
+  const size_t bucket_id = find_bucket(key, hash_value, found, n_probes);
+  if (found) return &buckets[bucket_id];
+  if (n_old_buckets == 0) return nullptr;
+  const size_t old_bucket_id = find_old_bucket(key, hash_value);
+  if (old_bucket_id == n_old_buckets) return nullptr;
+  return &old_buckets[old_bucket_id];
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+HashEntry<K, V, H>* HashBase<K, V, H, C, P, A>::find_old_entry(
+    const Q& key, const size_t hash_value) {
+  if (n_old_buckets == 0) return nullptr;
+  const size_t old_bucket_id = find_old_bucket(key, hash_value);
+  if (old_bucket_id == n_old_buckets) return nullptr;
+  return &old_buckets[old_bucket_id];
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+void HashBase<K, V, H, C, P, A>::for_each_entry(const F& handler) const {
+  if (n_keys == 0) return;
+  for (size_t i = find_filled_bucket(ctrls.data(), n_buckets, 0); i < n_buckets;
+       i = find_filled_bucket(ctrls.data(), n_buckets, i + 1)) {
+    handler(buckets[i]);
+  }
+  if (n_old_buckets == 0) return;
+  for (size_t i = find_filled_bucket(old_ctrls.data(), n_old_buckets, n_migrated_buckets);
+       i < n_old_buckets;
+       i = find_filled_bucket(old_ctrls.data(), n_old_buckets, i + 1)) {
+    handler(old_buckets[i]);
+  }
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+size_t HashBase<K, V, H, C, P, A>::find_filled_bucket(
+    const uint8_t* ctrls, const size_t n, size_t bucket_id) {
+  while (bucket_id < n) {
+    uint32_t filled_mask = CtrlGroup(ctrls + bucket_id).match_filled();
+    // The control bytes past the end mirror the first ones.
+    if (n - bucket_id < CtrlGroup::SIZE) filled_mask &= (1u << (n - bucket_id)) - 1;
+    if (filled_mask != 0) return bucket_id + __builtin_ctz(filled_mask);
+    bucket_id += CtrlGroup::SIZE;
+  }
+  return n;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::Iterator::skip_unfilled() {
+  const size_t n_buckets = base->n_buckets;
+  if (position < n_buckets) {
+    position = find_filled_bucket(base->ctrls.data(), n_buckets, position);
+    if (position < n_buckets) return;
+  }
+  const size_t n_old_buckets = base->n_old_buckets;
+  if (n_old_buckets == 0) return;
+  const size_t old_bucket_id = std::max(position - n_buckets, base->n_migrated_buckets);
+  position = n_buckets + find_filled_bucket(base->old_ctrls.data(), n_old_buckets, old_bucket_id);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::check_balance(const size_t n_probes) {
+  if (n_probes > stats.max_n_probes) stats.max_n_probes = n_probes;
+  if (n_probes <= MAX_N_PROBES) return;
+  if (n_keys >= n_buckets / 4) {
     reserve_n_buckets(static_cast<size_t>(n_buckets * 1.3));
+    return;
+  }
+  if (n_keys < n_reseed_keys * 2) return;
+  n_reseed_keys = n_keys;
+  stats.n_reseeds++;
+  set_seed(mix_seed(seed + 0x9E3779B97F4A7C15ull, reinterpret_cast<uintptr_t>(this)) | 1);
+  if (unbalanced_handler) {
+    unbalanced_handler(stats);
+  } else if (!unbalanced_warned) {
+    fprintf(stderr, "Warning: Hash container is unbalanced! Reseeded.\n");
+    unbalanced_warned = true;
   }
 }
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::unset(const K& key, const size_t hash_value) {
-  size_t bucket_id = hash_value % n_buckets;
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+size_t HashBase<K, V, H, C, P, A>::find_bucket(
+    const Q& key, const size_t hash_value, bool& found, size_t& n_probes) const {
+  const CtrlProbe probe = probe_ctrl_groups(
+      ctrls.data(),
+      n_buckets,
+      capacity.get_bucket_id(hash_value),
+      Ctrl::get_tag(hash_value),
+      [&](const size_t bucket_id) {
+        return buckets[bucket_id].key_equals(key, hash_value, key_store);
+      },
+      [&](const size_t last_bucket_id, const size_t n_last_probes) {
+        // The key cannot lie beyond an entry that is closer to its home than the key would be.
+        return P::ROBIN_HOOD && get_probe_distance(last_bucket_id) < n_last_probes;
+      });
+  found = probe.found;
+  n_probes = probe.n_probes;
+  return probe.bucket_id;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+size_t HashBase<K, V, H, C, P, A>::insert_bucket(const size_t hash_value, const size_t bucket_id) {
+  if (!P::ROBIN_HOOD) return bucket_id;
+  size_t insert_bucket_id = capacity.get_bucket_id(hash_value);
   size_t n_probes = 0;
-  while (n_probes < n_buckets) {
-    if (!buckets.at(bucket_id).filled) {
-      return;
-    } else if (buckets.at(bucket_id).key_equals(key, hash_value)) {
-      buckets.at(bucket_id).filled = false;
-      n_keys--;
-      // Find a valid entry to fill the spot if exists.
-      size_t swap_bucket_id = (bucket_id + 1) % n_buckets;
-      while (buckets.at(swap_bucket_id).filled) {
-        const size_t swap_origin_id = buckets.at(swap_bucket_id).hash_value % n_buckets;
-        if ((swap_bucket_id < swap_origin_id && swap_origin_id <= bucket_id) ||
-            (swap_origin_id <= bucket_id && bucket_id < swap_bucket_id) ||
-            (bucket_id < swap_bucket_id && swap_bucket_id < swap_origin_id)) {
-          buckets.at(bucket_id) = buckets.at(swap_bucket_id);
-          buckets.at(swap_bucket_id).filled = false;
-          bucket_id = swap_bucket_id;
-        }
-        swap_bucket_id = (swap_bucket_id + 1) % n_buckets;
-      }
-      return;
-    } else {
-      n_probes++;
-      bucket_id = (bucket_id + 1) % n_buckets;
+  while (Ctrl::is_filled(ctrls[insert_bucket_id]) &&
+         get_probe_distance(insert_bucket_id) >= n_probes) {
+    insert_bucket_id = next_bucket_id(insert_bucket_id);
+    n_probes++;
+  }
+  if (!Ctrl::is_filled(ctrls[insert_bucket_id])) return insert_bucket_id;
+
+  // Shift the rest of the run by one bucket.
+  size_t empty_bucket_id = find_empty_bucket(insert_bucket_id);
+  while (empty_bucket_id != insert_bucket_id) {
+    const size_t prev_bucket_id = empty_bucket_id == 0 ? n_buckets - 1 : empty_bucket_id - 1;
+    buckets[empty_bucket_id] = std::move(buckets[prev_bucket_id]);
+    set_ctrl(empty_bucket_id, ctrls[prev_bucket_id]);
+    empty_bucket_id = prev_bucket_id;
+  }
+  return insert_bucket_id;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::set_ctrl(const size_t bucket_id, const uint8_t ctrl) {
+  ctrls[bucket_id] = ctrl;
+  if (bucket_id < CtrlGroup::SIZE - 1) ctrls[n_buckets + bucket_id] = ctrl;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::unset(const K& key, const size_t hash_value) {
+  migrate();
+  bool found;
+  size_t n_probes;
+  size_t bucket_id = find_bucket(key, hash_value, found, n_probes);
+  if (!found) {
+    if (n_old_buckets == 0) return;
+    const size_t old_bucket_id = find_old_bucket(key, hash_value);
+    if (old_bucket_id == n_old_buckets) return;
+    set_old_ctrl(old_bucket_id, Ctrl::DELETED);
+    n_keys--;
+    return;
+  }
+  erase_bucket(bucket_id);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::erase_bucket(size_t bucket_id) {
+  n_keys--;
+  // Find a valid entry to fill the spot if exists, i.e. one whose probe sequence passes it.
+  // Robin Hood runs are sorted by home bucket, so the rest of the run shifts back as a whole
+  // until an entry already at its home bucket.
+  size_t swap_bucket_id = next_bucket_id(bucket_id);
+  size_t n_swap_probes = 1;
+  while (Ctrl::is_filled(ctrls[swap_bucket_id])) {
+    const size_t swap_probe_distance = get_probe_distance(swap_bucket_id);
+    if (P::ROBIN_HOOD && swap_probe_distance == 0) break;
+    if (swap_probe_distance >= n_swap_probes) {
+      buckets[bucket_id] = std::move(buckets[swap_bucket_id]);
+      set_ctrl(bucket_id, ctrls[swap_bucket_id]);
+      bucket_id = swap_bucket_id;
+      n_swap_probes = 0;
     }
+    swap_bucket_id = next_bucket_id(swap_bucket_id);
+    n_swap_probes++;
   }
+  set_ctrl(bucket_id, Ctrl::EMPTY);
 }
 
-template <class K, class V, class H>
-bool HashBase<K, V, H>::has(const K& key, const size_t hash_value) const {
-  size_t bucket_id = hash_value % n_buckets;
-  size_t n_probes = 0;
-  while (n_probes < n_buckets) {
-    if (!buckets.at(bucket_id).filled) {
-      return false;
-    } else if (buckets.at(bucket_id).key_equals(key, hash_value)) {
-      return true;
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+size_t HashBase<K, V, H, C, P, A>::erase_entries_if(const F& pred) {
+  complete_rehash();
+  const size_t n_keys_prev = n_keys;
+  // Scan from an empty bucket, which no run crosses, so that the shifts of erase_bucket only move
+  // the entries not visited yet, into the bucket just erased, which is then visited again.
+  const size_t end_bucket_id = find_empty_bucket(0);
+  size_t bucket_id = next_bucket_id(end_bucket_id);
+  while (n_keys > 0 && bucket_id != end_bucket_id) {
+    if (Ctrl::is_filled(ctrls[bucket_id]) && pred(buckets[bucket_id])) {
+      erase_bucket(bucket_id);
     } else {
-      n_probes++;
-      bucket_id = (bucket_id + 1) % n_buckets;
+      bucket_id = next_bucket_id(bucket_id);
     }
   }
-  return false;
+  if (n_keys < n_buckets * min_load_factor) {
+    shrink_to_fit();
+  } else if (n_keys < n_keys_prev) {
+    compact_key_store();
+  }
+  return n_keys_prev - n_keys;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+bool HashBase<K, V, H, C, P, A>::has(const Q& key, const size_t hash_value) const {
+  return find_entry(key, hash_value) != nullptr;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::has_many(
+    const K* keys, const size_t* hash_values, const size_t n, bool* res) const {
+  for_each_prefetched(hash_values, n, [&](const size_t i) {
+    res[i] = find_entry(keys[i], hash_values[i]) != nullptr;
+  });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::prefetch(const size_t hash_value) const {
+  const size_t bucket_id = capacity.get_bucket_id(hash_value);
+  __builtin_prefetch(&ctrls[bucket_id]);
+  __builtin_prefetch(&buckets[bucket_id]);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+void HashBase<K, V, H, C, P, A>::for_each_hashed(
+    const K* keys, const size_t n, const F& handler) const {
+  for_each_hash_chunk(
+      hasher, keys, n, [&](const size_t begin, const size_t* hash_values, const size_t n_chunk) {
+        for_each_prefetched(hash_values, n_chunk, [&](const size_t i) {
+          handler(begin + i, hash_values[i]);
+        });
+      });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+void HashBase<K, V, H, C, P, A>::for_each_prefetched(
+    const size_t* hash_values, const size_t n, const F& handler) const {
+  for (size_t i = 0; i < n && i < N_PREFETCH_AHEAD; i++) prefetch(hash_values[i]);
+  for (size_t i = 0; i < n; i++) {
+    if (i + N_PREFETCH_AHEAD < n) prefetch(hash_values[i + N_PREFETCH_AHEAD]);
+    handler(i);
+  }
 }
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::clear() {
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::clear() {
+  if (n_old_buckets > 0) clear_old_buckets();
+  key_store.clear();
   if (n_keys == 0) return;
+  ctrls.assign(n_buckets + CtrlGroup::SIZE - 1, static_cast<uint8_t>(Ctrl::EMPTY));
+  n_keys = 0;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::clear_and_shrink() {
+  if (reallocate_handler) reallocate_handler();
+  Buckets().swap(buckets);
+  clear_old_buckets();
+  key_store = typename HashEntry<K, V, H>::Store();
+  n_keys = 0;
+  init_buckets(N_INITIAL_BUCKETS);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::shrink_to_fit() {
+  const size_t n_fit_buckets = C::get_n_buckets(n_keys / max_load_factor);
+  if (n_fit_buckets < n_buckets) rehash(n_fit_buckets);
+  compact_key_store();
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashBase<K, V, H, C, P, A>::compact_key_store(std::true_type) {
+  typename HashEntry<K, V, H>::Store compacted;
   for (size_t i = 0; i < n_buckets; i++) {
-    buckets.at(i).filled = false;
+    if (Ctrl::is_filled(ctrls[i])) buckets[i].move_key_bytes(key_store, compacted);
   }
-  n_keys = 0;
+  // The entries not migrated yet by an incremental rehash.
+  for (size_t i = 0; i < n_old_buckets; i++) {
+    if (Ctrl::is_filled(old_ctrls[i])) old_buckets[i].move_key_bytes(key_store, compacted);
+  }
+  compacted.shrink_to_fit();
+  key_store = std::move(compacted);
 }
 
-template <class K, class V, class H>
-void HashBase<K, V, H>::clear_and_shrink() {
-  buckets.resize(N_INITIAL_BUCKETS);
-  n_buckets = N_INITIAL_BUCKETS;
-  clear();
+inline void HashStats::merge(const HashStats& other) {
+  if (other.max_n_probes > max_n_probes) max_n_probes = other.max_n_probes;
+  n_rehashes += other.n_rehashes;
+  n_reseeds += other.n_reseeds;
 }
+
 }  // namespace hash
 }  // namespace internal
 }  // namespace fgpl
@@ -1,60 +1,154 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <string>
 #include <type_traits>
+#include <utility>
+#include "string_arena.h"
 
 namespace fgpl {
 namespace internal {
 namespace hash {
 
-template <class K, class V>
-class HashEntry {
+// Whether the entries can drop the stored hash value and recompute it from the key on demand.
+// Holds for integral keys with the standard hasher. Specialize it to opt in other cheap hashers.
+template <class K, class H>
+class IsCompactKey {
  public:
-  K key;
+  constexpr static bool value = std::is_integral<K>::value && std::is_same<H, std::hash<K>>::value;
+};
 
-  size_t hash_value;
+// Whether the entries keep the bytes of their keys in a StringArena owned by the table.
+template <class K, class H>
+class IsArenaKey {
+ public:
+  constexpr static bool value = false;
+};
 
-  V value;
+template <>
+class IsArenaKey<std::string, ArenaStringHasher> {
+ public:
+  constexpr static bool value = true;
+};
+
+// Storage shared by the keys of a table. Keys stored inline need none.
+class NoKeyStore {
+ public:
+  const char* get_data(const size_t) const { return nullptr; }
+
+  size_t get_n_bytes() const { return 0; }
 
-  bool filled;
+  void clear() {}
+};
+
+template <
+    class K,
+    class H,
+    bool COMPACT = IsCompactKey<K, H>::value,
+    bool ARENA = IsArenaKey<K, H>::value>
+class HashKey {
+ public:
+  using Store = NoKeyStore;
 
-  HashEntry() : filled(false){};
+  K key;
+
+  size_t hash_value;
 
-  void fill(const K& key, const size_t hash_value, const V& value) {
-    this->key = key;
+  template <class KK>
+  void fill(KK&& key, const size_t hash_value, Store&) {
+    this->key = std::forward<KK>(key);
     this->hash_value = hash_value;
-    this->value = value;
-    filled = true;
   }
 
-  bool key_equals(const K& key, const size_t hash_value) const {
+  template <class Q, class S>
+  bool key_equals(const Q& key, const size_t hash_value, const S&) const {
     return this->hash_value == hash_value && this->key == key;
   }
+
+  const K& get_key(const Store&, K&) const { return key; }
+
+  size_t get_hash_value(const H&) const { return hash_value; }
 };
 
-// For hash set.
-template <class K>
-class HashEntry<K, void> {
+// Stores the key only, which halves the entries of integer sets.
+template <class K, class H>
+class HashKey<K, H, true, false> {
  public:
+  using Store = NoKeyStore;
+
   K key;
 
-  size_t hash_value;
+  template <class KK>
+  void fill(KK&& key, const size_t, Store&) {
+    this->key = std::forward<KK>(key);
+  }
+
+  template <class Q, class S>
+  bool key_equals(const Q& key, const size_t, const S&) const {
+    return this->key == key;
+  }
 
-  bool filled;
+  const K& get_key(const Store&, K&) const { return key; }
 
-  HashEntry() : filled(false){};
+  size_t get_hash_value(const H& hasher) const { return hasher(key); }
+};
+
+// Refers to the bytes of the key in the arena of the table, so that inserting a key copies it
+// into the arena without a heap allocation, and moving the entry moves 16 bytes.
+template <class K, class H>
+class HashKey<K, H, false, true> {
+ public:
+  using Store = StringArena;
 
-  void fill(const K& key, const size_t hash_value) {
-    this->key = key;
+  size_t hash_value;
+
+  template <class KK>
+  void fill(const KK& key, const size_t hash_value, Store& store) {
+    offset = store.append(key.data(), key.size());
+    size = key.size();
     this->hash_value = hash_value;
-    filled = true;
   }
 
-  bool key_equals(const K& key, const size_t hash_value) const {
-    return this->hash_value == hash_value && this->key == key;
+  // The store may be anything with get_data, such as the bytes of a mapped file.
+  template <class Q, class S>
+  bool key_equals(const Q& key, const size_t hash_value, const S& store) const {
+    return this->hash_value == hash_value && size == key.size() &&
+           std::memcmp(store.get_data(offset), key.data(), size) == 0;
+  }
+
+  // Appends the bytes of the key to the other store, such as a compacted arena, and refers there.
+  void move_key_bytes(const Store& store, Store& new_store) {
+    offset = new_store.append(store.get_data(offset), size);
   }
+
+  // Materializes the key into the buffer, which reuses its capacity across calls.
+  const K& get_key(const Store& store, K& buf) const {
+    buf.assign(store.get_data(offset), size);
+    return buf;
+  }
+
+  size_t get_hash_value(const H&) const { return hash_value; }
+
+ private:
+  uint64_t offset : 40;
+
+  uint64_t size : 24;
 };
+
+// The key is filled through fill. The value is left to the caller so that it can be moved or
+// built in place.
+template <class K, class V, class H = std::hash<K>>
+class HashEntry : public HashKey<K, H> {
+ public:
+  V value;
+};
+
+// For hash set.
+template <class K, class H>
+class HashEntry<K, void, H> : public HashKey<K, H> {};
 }  // namespace hash
 }  // namespace internal
 }  // namespace fgpl
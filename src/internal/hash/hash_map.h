@@ -1,131 +1,441 @@
 #pragma once
 
 #include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "../../reducer.h"
+#include "frozen_hash_map.h"
 #include "hash_base.h"
+#include "mapped_file.h"
 
 namespace fgpl {
 namespace internal {
 namespace hash {
 
 // A linear probing hash map that requires providing hash values when use.
-template <class K, class V, class H = std::hash<K>>
-class HashMap : public HashBase<K, V, H> {
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing,
+    template <class> class A = std::allocator>
+class HashMap : public HashBase<K, V, H, C, P, A> {
  public:
-  void set(
-      const K& key,
-      const size_t hash_value,
-      const V& value,
-      const std::function<void(V&, const V&)>& reducer);
+  // The key of set, get and upsert may be of any type Q the hasher accepts in place of K, which is
+  // only converted to K when inserted. See IsTransparentKey.
+  template <class Q, class R>
+  void set(const Q& key, const size_t hash_value, const V& value, const R& reducer);
 
-  V get(const K& key, const size_t hash_value, const V& default_value) const;
+  template <class R>
+  void set(K&& key, const size_t hash_value, V&& value, const R& reducer);
 
-  void for_each(const std::function<void(const K& key, const size_t hash_value, const V& value)>&
-                    handler) const;
+  // Sets the value of the key to the one constructed from the arguments.
+  template <class... Args>
+  void emplace(const K& key, const size_t hash_value, Args&&... args);
 
-  using HashBase<K, V, H>::max_load_factor;
+  template <class... Args>
+  void emplace(K&& key, const size_t hash_value, Args&&... args);
 
-  using HashBase<K, V, H>::reserve_n_buckets;
+  // Inserts the value constructed from the arguments only if the key does not exist, in which case
+  // the arguments are left untouched. Returns whether the key is inserted.
+  template <class... Args>
+  bool try_emplace(const K& key, const size_t hash_value, Args&&... args);
 
-  using HashBase<K, V, H>::clear;
+  template <class... Args>
+  bool try_emplace(K&& key, const size_t hash_value, Args&&... args);
 
-  using HashBase<K, V, H>::reserve;
+  // Calls updater(value) on the value of the key if exists, otherwise inserts the key and calls
+  // creator(value), which must assign the value of the new entry. Returns whether it is inserted.
+  template <class KK, class F, class G>
+  bool upsert(KK&& key, const size_t hash_value, const F& updater, const G& creator);
 
+  template <class Q>
+  V get(const Q& key, const size_t hash_value, const V& default_value) const;
+
+  // Returns the value of the key in place, or nullptr if not found. Writes to the map invalidate
+  // the pointer.
+  template <class Q>
+  const V* find(const Q& key, const size_t hash_value) const;
+
+  template <class Q>
+  V* find(const Q& key, const size_t hash_value);
+
+  // Returns the value of the key in place, inserting the default value first if not found, so that
+  // a read-modify-write probes once. Writes to the map invalidate the reference.
+  template <class Q>
+  V& get_or_insert(const Q& key, const size_t hash_value, const V& default_value);
+
+  void get_many(
+      const K* keys,
+      const size_t* hash_values,
+      const size_t n,
+      V* values,
+      const V& default_value) const;
+
+  template <class F>
+  void for_each(const F& handler) const;
+
+  // Erases the entries for which pred(key, hash_value, value) is true in a single pass.
+  // Returns the number of entries erased.
+  template <class F>
+  size_t erase_if(const F& pred);
+
+  // Keeps only the entries for which pred(key, hash_value, value) is true.
+  // Returns the number of entries erased.
+  template <class F>
+  size_t retain(const F& pred);
+
+  using HashBase<K, V, H, C, P, A>::max_load_factor;
+
+  using HashBase<K, V, H, C, P, A>::reserve_n_buckets;
+
+  using HashBase<K, V, H, C, P, A>::clear;
+
+  using HashBase<K, V, H, C, P, A>::reserve;
+
+  using HashBase<K, V, H, C, P, A>::min_load_factor;
+
+  using HashBase<K, V, H, C, P, A>::shrink_to_fit;
+
+  using HashBase<K, V, H, C, P, A>::is_rehashing;
+
+  using HashBase<K, V, H, C, P, A>::complete_rehash;
+
+  using HashBase<K, V, H, C, P, A>::get_seed;
+
+  using HashBase<K, V, H, C, P, A>::get_stats;
+
+  // Trivially copyable keys and values are written as contiguous arrays of the keys and values,
+  // which parse copies back in bulk and inserts with the buckets prefetched a chunk ahead.
   template <class B>
-  void serialize(B& buf) const;
+  void serialize(B& buf) const {
+    serialize(buf, std::integral_constant<bool, BULK_SERIALIZABLE>());
+  }
 
   template <class B>
-  void parse(B& buf);
+  void parse(B& buf) {
+    parse(buf, std::integral_constant<bool, BULK_SERIALIZABLE>());
+  }
+
+  // Writes the table as is to a file that MappedHashMap maps for lookups without parsing.
+  // Requires trivially copyable entries, and the same hasher, capacity and probing policies
+  // and hash values on the reading side.
+  void save(const std::string& path) const;
+
+  // Copies the entries into an immutable table for the read-only phases, see FrozenHashMap.
+  FrozenHashMap<K, V, H> freeze() const;
 
  protected:
-  using HashBase<K, V, H>::n_keys;
+  using HashBase<K, V, H, C, P, A>::n_keys;
+
+  using HashBase<K, V, H, C, P, A>::n_buckets;
 
-  using HashBase<K, V, H>::n_buckets;
+  using HashBase<K, V, H, C, P, A>::buckets;
 
-  using HashBase<K, V, H>::buckets;
+  using HashBase<K, V, H, C, P, A>::ctrls;
 
-  using HashBase<K, V, H>::check_balance;
+  using HashBase<K, V, H, C, P, A>::hasher;
+
+  using HashBase<K, V, H, C, P, A>::key_store;
+
+  using HashBase<K, V, H, C, P, A>::check_balance;
+
+  using HashBase<K, V, H, C, P, A>::find_bucket;
+
+  using HashBase<K, V, H, C, P, A>::insert_bucket;
+
+  using HashBase<K, V, H, C, P, A>::set_ctrl;
+
+  using HashBase<K, V, H, C, P, A>::for_each_prefetched;
+
+  using HashBase<K, V, H, C, P, A>::for_each_hashed;
+
+  using HashBase<K, V, H, C, P, A>::find_entry;
+
+  using HashBase<K, V, H, C, P, A>::find_old_entry;
+
+  using HashBase<K, V, H, C, P, A>::migrate;
+
+  using HashBase<K, V, H, C, P, A>::for_each_entry;
+
+  using HashBase<K, V, H, C, P, A>::erase_entries_if;
+
+ private:
+  constexpr static bool BULK_SERIALIZABLE =
+      std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value;
+
+  template <class B>
+  void serialize(B& buf, std::false_type) const;
+
+  template <class B>
+  void serialize(B& buf, std::true_type) const;
+
+  template <class B>
+  void parse(B& buf, std::false_type);
+
+  template <class B>
+  void parse(B& buf, std::true_type);
 };
 
-template <class K, class V, class H>
-void HashMap<K, V, H>::set(
-    const K& key,
-    const size_t hash_value,
-    const V& value,
-    const std::function<void(V&, const V&)>& reducer) {
-  size_t bucket_id = hash_value % n_buckets;
-  size_t n_probes = 0;
-  while (n_probes < n_buckets) {
-    if (!buckets.at(bucket_id).filled) {
-      buckets.at(bucket_id).fill(key, hash_value, value);
-      n_keys++;
-      if (n_buckets * max_load_factor <= n_keys) {
-        reserve_n_buckets(static_cast<size_t>(n_buckets * 1.3));
-      }
-      break;
-    } else if (buckets.at(bucket_id).key_equals(key, hash_value)) {
-      reducer(buckets.at(bucket_id).value, value);
-      break;
-    } else {
-      n_probes++;
-      bucket_id = (bucket_id + 1) % n_buckets;
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q, class R>
+void HashMap<K, V, H, C, P, A>::set(
+    const Q& key, const size_t hash_value, const V& value, const R& reducer) {
+  upsert(
+      key,
+      hash_value,
+      [&](V& bucket_value) { reducer(bucket_value, value); },
+      [&](V& bucket_value) { bucket_value = value; });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class R>
+void HashMap<K, V, H, C, P, A>::set(K&& key, const size_t hash_value, V&& value, const R& reducer) {
+  upsert(
+      std::move(key),
+      hash_value,
+      [&](V& bucket_value) { reducer(bucket_value, value); },
+      [&](V& bucket_value) { bucket_value = std::move(value); });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class... Args>
+void HashMap<K, V, H, C, P, A>::emplace(const K& key, const size_t hash_value, Args&&... args) {
+  const auto& assigner = [&](V& bucket_value) { bucket_value = V(std::forward<Args>(args)...); };
+  upsert(key, hash_value, assigner, assigner);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class... Args>
+void HashMap<K, V, H, C, P, A>::emplace(K&& key, const size_t hash_value, Args&&... args) {
+  const auto& assigner = [&](V& bucket_value) { bucket_value = V(std::forward<Args>(args)...); };
+  upsert(std::move(key), hash_value, assigner, assigner);
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class... Args>
+bool HashMap<K, V, H, C, P, A>::try_emplace(const K& key, const size_t hash_value, Args&&... args) {
+  return upsert(
+      key,
+      hash_value,
+      [](V&) {},
+      [&](V& bucket_value) { bucket_value = V(std::forward<Args>(args)...); });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class... Args>
+bool HashMap<K, V, H, C, P, A>::try_emplace(K&& key, const size_t hash_value, Args&&... args) {
+  return upsert(
+      std::move(key),
+      hash_value,
+      [](V&) {},
+      [&](V& bucket_value) { bucket_value = V(std::forward<Args>(args)...); });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class KK, class F, class G>
+bool HashMap<K, V, H, C, P, A>::upsert(
+    KK&& key, const size_t hash_value, const F& updater, const G& creator) {
+  migrate();
+  bool found;
+  size_t n_probes;
+  size_t bucket_id = find_bucket(key, hash_value, found, n_probes);
+  bool inserted = false;
+  HashEntry<K, V, H>* old_entry;
+  if (found) {
+    updater(buckets[bucket_id].value);
+  } else if ((old_entry = find_old_entry(key, hash_value)) != nullptr) {
+    updater(old_entry->value);
+  } else if (bucket_id < n_buckets) {
+    bucket_id = insert_bucket(hash_value, bucket_id);
+    buckets[bucket_id].fill(std::forward<KK>(key), hash_value, key_store);
+    creator(buckets[bucket_id].value);
+    set_ctrl(bucket_id, Ctrl::get_tag(hash_value));
+    n_keys++;
+    inserted = true;
+    if (n_buckets * max_load_factor <= n_keys) {
+      reserve_n_buckets(static_cast<size_t>(n_buckets * 1.3));
     }
   }
   check_balance(n_probes);
+  return inserted;
 }
 
-template <class K, class V, class H>
-V HashMap<K, V, H>::get(const K& key, const size_t hash_value, const V& default_value) const {
-  size_t bucket_id = hash_value % n_buckets;
-  size_t n_probes = 0;
-  while (n_probes < n_buckets) {
-    if (!buckets.at(bucket_id).filled) {
-      return default_value;
-    } else if (buckets.at(bucket_id).key_equals(key, hash_value)) {
-      return buckets.at(bucket_id).value;
-    } else {
-      n_probes++;
-      bucket_id = (bucket_id + 1) % n_buckets;
-    }
-  }
-  return default_value;
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+V HashMap<K, V, H, C, P, A>::get(
+    const Q& key, const size_t hash_value, const V& default_value) const {
+  const HashEntry<K, V, H>* entry = find_entry(key, hash_value);
+  if (entry == nullptr) return default_value;
+  return entry->value;
 }
 
-template <class K, class V, class H>
-void HashMap<K, V, H>::for_each(
-    const std::function<void(const K& key, const size_t hash_value, const V& value)>& handler)
-    const {
-  if (n_keys == 0) return;
-  for (size_t i = 0; i < n_buckets; i++) {
-    if (buckets.at(i).filled) {
-      handler(buckets.at(i).key, buckets.at(i).hash_value, buckets.at(i).value);
-    }
-  }
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+const V* HashMap<K, V, H, C, P, A>::find(const Q& key, const size_t hash_value) const {
+  const HashEntry<K, V, H>* entry = find_entry(key, hash_value);
+  if (entry == nullptr) return nullptr;
+  return &entry->value;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+V* HashMap<K, V, H, C, P, A>::find(const Q& key, const size_t hash_value) {
+  return const_cast<V*>(static_cast<const HashMap*>(this)->find(key, hash_value));
 }
 
-template <class K, class V, class H>
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class Q>
+V& HashMap<K, V, H, C, P, A>::get_or_insert(
+    const Q& key, const size_t hash_value, const V& default_value) {
+  const size_t n_rehashes_prev = get_stats().n_rehashes;
+  V* value_ptr = nullptr;
+  upsert(
+      key,
+      hash_value,
+      [&](V& bucket_value) { value_ptr = &bucket_value; },
+      [&](V& bucket_value) {
+        bucket_value = default_value;
+        value_ptr = &bucket_value;
+      });
+  // The insert may have rehashed the table, growing or reseeding it, and moved the entry.
+  if (get_stats().n_rehashes != n_rehashes_prev) value_ptr = find(key, hash_value);
+  return *value_ptr;
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashMap<K, V, H, C, P, A>::get_many(
+    const K* keys,
+    const size_t* hash_values,
+    const size_t n,
+    V* values,
+    const V& default_value) const {
+  for_each_prefetched(hash_values, n, [&](const size_t i) {
+    const HashEntry<K, V, H>* entry = find_entry(keys[i], hash_values[i]);
+    values[i] = entry == nullptr ? default_value : entry->value;
+  });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+void HashMap<K, V, H, C, P, A>::for_each(const F& handler) const {
+  K key_buf;
+  for_each_entry([&](const HashEntry<K, V, H>& entry) {
+    handler(entry.get_key(key_store, key_buf), entry.get_hash_value(hasher), entry.value);
+  });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+size_t HashMap<K, V, H, C, P, A>::erase_if(const F& pred) {
+  K key_buf;
+  return erase_entries_if([&](const HashEntry<K, V, H>& entry) {
+    return pred(entry.get_key(key_store, key_buf), entry.get_hash_value(hasher), entry.value);
+  });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class F>
+size_t HashMap<K, V, H, C, P, A>::retain(const F& pred) {
+  return erase_if([&](const K& key, const size_t hash_value, const V& value) {
+    return !pred(key, hash_value, value);
+  });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
 template <class B>
-void HashMap<K, V, H>::serialize(B& buf) const {
+void HashMap<K, V, H, C, P, A>::serialize(B& buf, std::false_type) const {
   buf << n_keys;
   const auto& handler = [&](const K& key, const size_t, const V& value) { buf << key << value; };
   for_each(handler);
 }
 
-template <class K, class V, class H>
+template <class K, class V, class H, class C, class P, template <class> class A>
 template <class B>
-void HashMap<K, V, H>::parse(B& buf) {
+void HashMap<K, V, H, C, P, A>::serialize(B& buf, std::true_type) const {
+  buf << n_keys;
+  if (n_keys == 0) return;
+  std::vector<K> keys;
+  std::vector<V> values;
+  keys.reserve(n_keys);
+  values.reserve(n_keys);
+  for_each([&](const K& key, const size_t, const V& value) {
+    keys.push_back(key);
+    values.push_back(value);
+  });
+  buf.write_char_array(reinterpret_cast<const char*>(keys.data()), n_keys * sizeof(K));
+  buf.write_char_array(reinterpret_cast<const char*>(values.data()), n_keys * sizeof(V));
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class B>
+void HashMap<K, V, H, C, P, A>::parse(B& buf, std::false_type) {
   size_t n_keys_buf;
   clear();
   buf >> n_keys_buf;
   reserve(n_keys_buf);
-  H hasher;
   K key;
   V value;
   for (size_t i = 0; i < n_keys_buf; i++) {
     buf >> key >> value;
-    set(key, hasher(key), value, Reducer<V>::keep);
+    const size_t hash_value = hasher(key);
+    set(std::move(key), hash_value, std::move(value), Reducer<V>::keep);
+  }
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+template <class B>
+void HashMap<K, V, H, C, P, A>::parse(B& buf, std::true_type) {
+  size_t n_keys_buf;
+  clear();
+  buf >> n_keys_buf;
+  if (n_keys_buf == 0) return;
+  reserve(n_keys_buf);
+  std::vector<K> keys(n_keys_buf);
+  std::vector<V> values(n_keys_buf);
+  buf.read_char_array(reinterpret_cast<char*>(keys.data()), n_keys_buf * sizeof(K));
+  buf.read_char_array(reinterpret_cast<char*>(values.data()), n_keys_buf * sizeof(V));
+  // Reserved above, so the table does not move while the buckets ahead are prefetched.
+  for_each_hashed(keys.data(), n_keys_buf, [&](const size_t i, const size_t hash_value) {
+    set(std::move(keys[i]), hash_value, std::move(values[i]), Reducer<V>::keep);
+  });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+FrozenHashMap<K, V, H> HashMap<K, V, H, C, P, A>::freeze() const {
+  return FrozenHashMap<K, V, H>(
+      n_keys, [&](const typename FrozenHashMap<K, V, H>::EntryHandler& handler) {
+        for_each(handler);
+      });
+}
+
+template <class K, class V, class H, class C, class P, template <class> class A>
+void HashMap<K, V, H, C, P, A>::save(const std::string& path) const {
+  static_assert(
+      std::is_trivially_copyable<HashEntry<K, V, H>>::value,
+      "Only tables of trivially copyable entries can be saved.");
+  if (is_rehashing()) {
+    HashMap<K, V, H, C, P, A> rehashed(*this);
+    rehashed.complete_rehash();
+    rehashed.save(path);
+    return;
   }
+  MappedHashHeader header;
+  header.magic = MappedHashHeader::MAGIC;
+  header.version = MappedHashHeader::VERSION;
+  header.entry_size = sizeof(HashEntry<K, V, H>);
+  header.robin_hood = P::ROBIN_HOOD;
+  header.capacity = C::TAG;
+  header.seed = get_seed();
+  header.n_keys = n_keys;
+  header.n_buckets = n_buckets;
+  header.n_ctrls = ctrls.size();
+  header.n_key_bytes = key_store.get_n_bytes();
+  header.set_offsets();
+  header.write(path, ctrls.data(), buckets.data(), key_store.get_data(0));
 }
 
 }  // namespace hash
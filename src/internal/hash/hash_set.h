@@ -1,6 +1,8 @@
 #pragma once
 
 #include <functional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "hash_base.h"
 
@@ -9,93 +11,195 @@ namespace internal {
 namespace hash {
 
 // A linear probing hash map that requires providing hash values when use.
-template <class K, class H = std::hash<K>>
-class HashSet : public HashBase<K, void, H> {
+template <
+    class K,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing,
+    template <class> class A = std::allocator>
+class HashSet : public HashBase<K, void, H, C, P, A> {
  public:
-  void set(const K& key, const size_t hash_value);
+  void set(const K& key, const size_t hash_value) { insert(key, hash_value); }
 
-  void for_each(const std::function<void(const K& key, const size_t hash_value)>& handler) const;
+  void set(K&& key, const size_t hash_value) { insert(std::move(key), hash_value); }
 
-  using HashBase<K, void, H>::max_load_factor;
+  template <class F>
+  void for_each(const F& handler) const;
 
-  using HashBase<K, void, H>::reserve_n_buckets;
+  // Erases the entries for which pred(key, hash_value) is true in a single pass.
+  // Returns the number of entries erased.
+  template <class F>
+  size_t erase_if(const F& pred);
 
-  using HashBase<K, void, H>::clear;
+  // Keeps only the entries for which pred(key, hash_value) is true.
+  // Returns the number of entries erased.
+  template <class F>
+  size_t retain(const F& pred);
 
-  using HashBase<K, void, H>::reserve;
+  using HashBase<K, void, H, C, P, A>::max_load_factor;
 
+  using HashBase<K, void, H, C, P, A>::reserve_n_buckets;
+
+  using HashBase<K, void, H, C, P, A>::clear;
+
+  using HashBase<K, void, H, C, P, A>::reserve;
+
+  using HashBase<K, void, H, C, P, A>::min_load_factor;
+
+  using HashBase<K, void, H, C, P, A>::shrink_to_fit;
+
+  // Trivially copyable keys are written as a contiguous array, see HashMap::serialize.
   template <class B>
-  void serialize(B& buf) const;
+  void serialize(B& buf) const {
+    serialize(buf, std::is_trivially_copyable<K>());
+  }
 
   template <class B>
-  void parse(B& buf);
+  void parse(B& buf) {
+    parse(buf, std::is_trivially_copyable<K>());
+  }
 
  protected:
-  using HashBase<K, void, H>::n_keys;
+  using HashBase<K, void, H, C, P, A>::n_keys;
+
+  using HashBase<K, void, H, C, P, A>::n_buckets;
+
+  using HashBase<K, void, H, C, P, A>::buckets;
+
+  using HashBase<K, void, H, C, P, A>::ctrls;
+
+  using HashBase<K, void, H, C, P, A>::hasher;
+
+  using HashBase<K, void, H, C, P, A>::key_store;
+
+  using HashBase<K, void, H, C, P, A>::check_balance;
+
+  using HashBase<K, void, H, C, P, A>::find_bucket;
+
+  using HashBase<K, void, H, C, P, A>::insert_bucket;
+
+  using HashBase<K, void, H, C, P, A>::set_ctrl;
+
+  using HashBase<K, void, H, C, P, A>::find_old_entry;
+
+  using HashBase<K, void, H, C, P, A>::migrate;
+
+  using HashBase<K, void, H, C, P, A>::for_each_entry;
+
+  using HashBase<K, void, H, C, P, A>::erase_entries_if;
+
+  using HashBase<K, void, H, C, P, A>::for_each_hashed;
+
+  // The key may be of any type the hasher accepts in place of K, see IsTransparentKey.
+  template <class KK>
+  void insert(KK&& key, const size_t hash_value);
+
+ private:
+  template <class B>
+  void serialize(B& buf, std::false_type) const;
 
-  using HashBase<K, void, H>::n_buckets;
+  template <class B>
+  void serialize(B& buf, std::true_type) const;
 
-  using HashBase<K, void, H>::buckets;
+  template <class B>
+  void parse(B& buf, std::false_type);
 
-  using HashBase<K, void, H>::check_balance;
+  template <class B>
+  void parse(B& buf, std::true_type);
 };
 
-template <class K, class H>
-void HashSet<K, H>::set(const K& key, const size_t hash_value) {
-  size_t bucket_id = hash_value % n_buckets;
-  size_t n_probes = 0;
-  while (n_probes < n_buckets) {
-    if (!buckets.at(bucket_id).filled) {
-      buckets.at(bucket_id).fill(key, hash_value);
-      n_keys++;
-      if (n_buckets * max_load_factor <= n_keys) {
-        reserve_n_buckets(static_cast<size_t>(n_buckets * 1.3));
-      }
-      break;
-    } else if (buckets.at(bucket_id).key_equals(key, hash_value)) {
-      break;
-    } else {
-      n_probes++;
-      bucket_id = (bucket_id + 1) % n_buckets;
+template <class K, class H, class C, class P, template <class> class A>
+template <class KK>
+void HashSet<K, H, C, P, A>::insert(KK&& key, const size_t hash_value) {
+  migrate();
+  bool found;
+  size_t n_probes;
+  size_t bucket_id = find_bucket(key, hash_value, found, n_probes);
+  if (!found && bucket_id < n_buckets && find_old_entry(key, hash_value) == nullptr) {
+    bucket_id = insert_bucket(hash_value, bucket_id);
+    buckets[bucket_id].fill(std::forward<KK>(key), hash_value, key_store);
+    set_ctrl(bucket_id, Ctrl::get_tag(hash_value));
+    n_keys++;
+    if (n_buckets * max_load_factor <= n_keys) {
+      reserve_n_buckets(static_cast<size_t>(n_buckets * 1.3));
     }
   }
   check_balance(n_probes);
 }
 
-template <class K, class H>
-void HashSet<K, H>::for_each(
-    const std::function<void(const K& key, const size_t hash_value)>& handler) const {
-  if (n_keys == 0) return;
-  for (size_t i = 0; i < n_buckets; i++) {
-    if (buckets.at(i).filled) {
-      handler(buckets.at(i).key, buckets.at(i).hash_value);
-    }
-  }
+template <class K, class H, class C, class P, template <class> class A>
+template <class F>
+void HashSet<K, H, C, P, A>::for_each(const F& handler) const {
+  K key_buf;
+  for_each_entry([&](const HashEntry<K, void, H>& entry) {
+    handler(entry.get_key(key_store, key_buf), entry.get_hash_value(hasher));
+  });
+}
+
+template <class K, class H, class C, class P, template <class> class A>
+template <class F>
+size_t HashSet<K, H, C, P, A>::erase_if(const F& pred) {
+  K key_buf;
+  return erase_entries_if([&](const HashEntry<K, void, H>& entry) {
+    return pred(entry.get_key(key_store, key_buf), entry.get_hash_value(hasher));
+  });
 }
 
-template <class K, class H>
+template <class K, class H, class C, class P, template <class> class A>
+template <class F>
+size_t HashSet<K, H, C, P, A>::retain(const F& pred) {
+  return erase_if([&](const K& key, const size_t hash_value) { return !pred(key, hash_value); });
+}
+
+template <class K, class H, class C, class P, template <class> class A>
 template <class B>
-void HashSet<K, H>::serialize(B& buf) const {
+void HashSet<K, H, C, P, A>::serialize(B& buf, std::false_type) const {
   buf << n_keys;
   const auto& handler = [&](const K& key, const size_t) { buf << key; };
   for_each(handler);
 }
 
-template <class K, class H>
+template <class K, class H, class C, class P, template <class> class A>
 template <class B>
-void HashSet<K, H>::parse(B& buf) {
+void HashSet<K, H, C, P, A>::serialize(B& buf, std::true_type) const {
+  buf << n_keys;
+  if (n_keys == 0) return;
+  std::vector<K> keys;
+  keys.reserve(n_keys);
+  for_each([&](const K& key, const size_t) { keys.push_back(key); });
+  buf.write_char_array(reinterpret_cast<const char*>(keys.data()), n_keys * sizeof(K));
+}
+
+template <class K, class H, class C, class P, template <class> class A>
+template <class B>
+void HashSet<K, H, C, P, A>::parse(B& buf, std::false_type) {
   size_t n_keys_buf;
   clear();
   buf >> n_keys_buf;
   reserve(n_keys_buf);
-  H hasher;
   K key;
   for (size_t i = 0; i < n_keys_buf; i++) {
     buf >> key;
-    set(key, hasher(key));
+    const size_t hash_value = hasher(key);
+    set(std::move(key), hash_value);
   }
 }
 
+template <class K, class H, class C, class P, template <class> class A>
+template <class B>
+void HashSet<K, H, C, P, A>::parse(B& buf, std::true_type) {
+  size_t n_keys_buf;
+  clear();
+  buf >> n_keys_buf;
+  if (n_keys_buf == 0) return;
+  reserve(n_keys_buf);
+  std::vector<K> keys(n_keys_buf);
+  buf.read_char_array(reinterpret_cast<char*>(keys.data()), n_keys_buf * sizeof(K));
+  for_each_hashed(keys.data(), n_keys_buf, [&](const size_t i, const size_t hash_value) {
+    insert(std::move(keys[i]), hash_value);
+  });
+}
+
 }  // namespace hash
 }  // namespace internal
 }  // namespace fgpl
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// Layout of a saved hash table: this header, then the control bytes, the bucket array and the
+// key store bytes, each starting at a multiple of ALIGNMENT so that they can be used in place.
+class MappedHashHeader {
+ public:
+  constexpr static uint64_t MAGIC = 0x50414D4853484746ull;  // "FGHSHMAP"
+
+  constexpr static uint64_t VERSION = 3;
+
+  constexpr static size_t ALIGNMENT = 64;
+
+  uint64_t magic;
+
+  uint64_t version;
+
+  uint64_t entry_size;
+
+  uint64_t robin_hood;
+
+  // The TAG of the capacity policy.
+  uint64_t capacity;
+
+  uint64_t seed;
+
+  uint64_t n_keys;
+
+  uint64_t n_buckets;
+
+  uint64_t n_ctrls;
+
+  uint64_t n_key_bytes;
+
+  uint64_t ctrls_offset;
+
+  uint64_t buckets_offset;
+
+  uint64_t key_bytes_offset;
+
+  uint64_t file_size;
+
+  static uint64_t align(const uint64_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+  // Fills in the offsets from the sizes.
+  void set_offsets();
+
+  // Writes the header and the sections to the file.
+  void write(
+      const std::string& path,
+      const uint8_t* ctrls,
+      const void* buckets,
+      const char* key_bytes) const;
+};
+
+// A read-only, shared memory map of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile();
+
+  const char* get_data() const { return data; }
+
+  size_t get_size() const { return size; }
+
+ private:
+  const char* data;
+
+  size_t size;
+};
+
+inline void MappedHashHeader::set_offsets() {
+  ctrls_offset = align(sizeof(MappedHashHeader));
+  buckets_offset = align(ctrls_offset + n_ctrls);
+  key_bytes_offset = align(buckets_offset + n_buckets * entry_size);
+  file_size = key_bytes_offset + n_key_bytes;
+}
+
+inline void MappedHashHeader::write(
+    const std::string& path,
+    const uint8_t* ctrls,
+    const void* buckets,
+    const char* key_bytes) const {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) throw std::runtime_error("Cannot open " + path + " for writing.");
+  const std::vector<char> padding(ALIGNMENT, 0);
+  bool ok = fwrite(this, sizeof(MappedHashHeader), 1, file) == 1;
+  const auto& write_section = [&](const uint64_t offset, const void* data, const size_t n_bytes) {
+    const size_t n_padding_bytes = offset - ftell(file);
+    ok = ok && fwrite(padding.data(), 1, n_padding_bytes, file) == n_padding_bytes;
+    ok = ok && (n_bytes == 0 || fwrite(data, 1, n_bytes, file) == n_bytes);
+  };
+  write_section(ctrls_offset, ctrls, n_ctrls);
+  write_section(buckets_offset, buckets, n_buckets * entry_size);
+  write_section(key_bytes_offset, key_bytes, n_key_bytes);
+  ok = fclose(file) == 0 && ok;
+  if (!ok) throw std::runtime_error("Cannot write " + path + ".");
+}
+
+inline MappedFile::MappedFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Cannot open " + path + ".");
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot stat " + path + ".");
+  }
+  size = file_stat.st_size;
+  void* addr = size == 0 ? nullptr : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) throw std::runtime_error("Cannot map " + path + ".");
+  data = static_cast<const char*>(addr);
+}
+
+inline MappedFile::~MappedFile() {
+  if (data != nullptr) munmap(const_cast<char*>(data), size);
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
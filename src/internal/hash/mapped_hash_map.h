@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "capacity.h"
+#include "ctrl_group.h"
+#include "hash_entry.h"
+#include "mapped_file.h"
+#include "probing.h"
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// The key store bytes of a mapped table.
+class MappedKeyStore {
+ public:
+  const char* data;
+
+  const char* get_data(const size_t offset) const { return data + offset; }
+};
+
+// A read-only hash map over a file written by HashMap::save. The file is mapped shared, so the
+// pages are loaded on demand and shared by all the processes that map the same file.
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing>
+class MappedHashMap {
+ public:
+  explicit MappedHashMap(const std::string& path);
+
+  size_t get_n_keys() const { return n_keys; }
+
+  size_t get_n_buckets() const { return n_buckets; }
+
+  template <class Q>
+  V get(const Q& key, const size_t hash_value, const V& default_value) const;
+
+  template <class Q>
+  bool has(const Q& key, const size_t hash_value) const;
+
+ protected:
+  MappedFile file;
+
+  size_t n_keys;
+
+  size_t n_buckets;
+
+  const uint8_t* ctrls;
+
+  const HashEntry<K, V, H>* buckets;
+
+  MappedKeyStore key_store;
+
+  C capacity;
+
+  H hasher;
+
+  // Returns the entry of the key, or nullptr if not found.
+  template <class Q>
+  const HashEntry<K, V, H>* find_entry(const Q& key, const size_t hash_value) const;
+};
+
+template <class K, class V, class H, class C, class P>
+MappedHashMap<K, V, H, C, P>::MappedHashMap(const std::string& path) : file(path) {
+  static_assert(
+      std::is_trivially_copyable<HashEntry<K, V, H>>::value,
+      "Only tables of trivially copyable entries can be mapped.");
+  MappedHashHeader header;
+  if (file.get_size() < sizeof(MappedHashHeader)) {
+    throw std::runtime_error(path + " is not a saved hash map.");
+  }
+  std::memcpy(&header, file.get_data(), sizeof(MappedHashHeader));
+  if (header.magic != MappedHashHeader::MAGIC || header.version != MappedHashHeader::VERSION) {
+    throw std::runtime_error(path + " is not a saved hash map.");
+  }
+  if (header.entry_size != sizeof(HashEntry<K, V, H>) || header.robin_hood != P::ROBIN_HOOD ||
+      header.capacity != C::TAG || !C::is_valid_n_buckets(header.n_buckets) ||
+      header.n_ctrls != header.n_buckets + CtrlGroup::SIZE - 1) {
+    throw std::runtime_error(path + " is saved from a hash map of different types.");
+  }
+  if (header.file_size != file.get_size()) throw std::runtime_error(path + " is truncated.");
+  n_keys = header.n_keys;
+  n_buckets = header.n_buckets;
+  ctrls = reinterpret_cast<const uint8_t*>(file.get_data() + header.ctrls_offset);
+  buckets = reinterpret_cast<const HashEntry<K, V, H>*>(file.get_data() + header.buckets_offset);
+  key_store.data = file.get_data() + header.key_bytes_offset;
+  capacity.set_n_buckets(n_buckets);
+  capacity.set_seed(header.seed);
+}
+
+template <class K, class V, class H, class C, class P>
+template <class Q>
+V MappedHashMap<K, V, H, C, P>::get(
+    const Q& key, const size_t hash_value, const V& default_value) const {
+  const HashEntry<K, V, H>* entry = find_entry(key, hash_value);
+  if (entry == nullptr) return default_value;
+  return entry->value;
+}
+
+template <class K, class V, class H, class C, class P>
+template <class Q>
+bool MappedHashMap<K, V, H, C, P>::has(const Q& key, const size_t hash_value) const {
+  return find_entry(key, hash_value) != nullptr;
+}
+
+template <class K, class V, class H, class C, class P>
+template <class Q>
+const HashEntry<K, V, H>* MappedHashMap<K, V, H, C, P>::find_entry(
+    const Q& key, const size_t hash_value) const {
+  const CtrlProbe probe = probe_ctrl_groups(
+      ctrls,
+      n_buckets,
+      capacity.get_bucket_id(hash_value),
+      Ctrl::get_tag(hash_value),
+      [&](const size_t bucket_id) {
+        return buckets[bucket_id].key_equals(key, hash_value, key_store);
+      });
+  return probe.found ? &buckets[probe.bucket_id] : nullptr;
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
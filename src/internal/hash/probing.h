@@ -0,0 +1,27 @@
+#pragma once
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// New keys take the first empty bucket of their probe sequence.
+class LinearProbing {
+ public:
+  constexpr static bool ROBIN_HOOD = false;
+
+  constexpr static float DEFAULT_MAX_LOAD_FACTOR = 0.7;
+};
+
+// New keys displace the entries that are closer to their home buckets, which keeps every run
+// sorted by home bucket. Probe lengths stay short and even at high loads, and lookups of
+// missing keys stop once they pass where the key would have been.
+class RobinHoodProbing {
+ public:
+  constexpr static bool ROBIN_HOOD = true;
+
+  constexpr static float DEFAULT_MAX_LOAD_FACTOR = 0.9;
+};
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
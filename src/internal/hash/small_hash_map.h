@@ -0,0 +1,180 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include "../../reducer.h"
+#include "hash_map.h"
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// A hash map that keeps up to N entries inline, found by scanning their hash values, and moves
+// them to a heap HashMap on the first insert beyond N. Small maps are created, filled and
+// destroyed without touching the heap.
+template <class K, class V, size_t N, class H = std::hash<K>>
+class SmallHashMap {
+ public:
+  static_assert(N > 0, "SmallHashMap requires an inline capacity.");
+
+  constexpr static size_t N_INLINE_KEYS = N;
+
+  SmallHashMap() : n_inline_keys(0) {}
+
+  SmallHashMap(const SmallHashMap& m);
+
+  SmallHashMap(SmallHashMap&& m) = default;
+
+  SmallHashMap& operator=(const SmallHashMap& m);
+
+  SmallHashMap& operator=(SmallHashMap&& m) = default;
+
+  template <class R>
+  void set(const K& key, const size_t hash_value, const V& value, const R& reducer);
+
+  V get(const K& key, const size_t hash_value, const V& default_value) const;
+
+  bool has(const K& key, const size_t hash_value) const;
+
+  void unset(const K& key, const size_t hash_value);
+
+  size_t get_n_keys() const { return spilled ? spilled->get_n_keys() : n_inline_keys; }
+
+  // Whether the entries have moved to the heap map.
+  bool is_spilled() const { return spilled != nullptr; }
+
+  // Also frees the heap map, so that the map is inline again.
+  void clear();
+
+  template <class F>
+  void for_each(const F& handler) const;
+
+ protected:
+  size_t n_inline_keys;
+
+  K keys[N];
+
+  V values[N];
+
+  size_t hash_values[N];
+
+  std::unique_ptr<HashMap<K, V, H>> spilled;
+
+  H hasher;
+
+ private:
+  // Returns the inline slot of the key, or n_inline_keys if not found.
+  size_t find_inline(const K& key, const size_t hash_value) const;
+
+  void spill();
+};
+
+template <class K, class V, size_t N, class H>
+SmallHashMap<K, V, N, H>::SmallHashMap(const SmallHashMap& m) : n_inline_keys(0) {
+  *this = m;
+}
+
+template <class K, class V, size_t N, class H>
+SmallHashMap<K, V, N, H>& SmallHashMap<K, V, N, H>::operator=(const SmallHashMap& m) {
+  if (this == &m) return *this;
+  n_inline_keys = m.n_inline_keys;
+  for (size_t i = 0; i < n_inline_keys; i++) {
+    keys[i] = m.keys[i];
+    values[i] = m.values[i];
+    hash_values[i] = m.hash_values[i];
+  }
+  spilled.reset(m.spilled ? new HashMap<K, V, H>(*m.spilled) : nullptr);
+  return *this;
+}
+
+template <class K, class V, size_t N, class H>
+template <class R>
+void SmallHashMap<K, V, N, H>::set(
+    const K& key, const size_t hash_value, const V& value, const R& reducer) {
+  if (spilled) {
+    spilled->set(key, hash_value, value, reducer);
+    return;
+  }
+  const size_t slot = find_inline(key, hash_value);
+  if (slot < n_inline_keys) {
+    reducer(values[slot], value);
+    return;
+  }
+  if (n_inline_keys == N) {
+    spill();
+    spilled->set(key, hash_value, value, reducer);
+    return;
+  }
+  keys[n_inline_keys] = key;
+  values[n_inline_keys] = value;
+  hash_values[n_inline_keys] = hash_value;
+  n_inline_keys++;
+}
+
+template <class K, class V, size_t N, class H>
+V SmallHashMap<K, V, N, H>::get(
+    const K& key, const size_t hash_value, const V& default_value) const {
+  if (spilled) return spilled->get(key, hash_value, default_value);
+  const size_t slot = find_inline(key, hash_value);
+  return slot < n_inline_keys ? values[slot] : default_value;
+}
+
+template <class K, class V, size_t N, class H>
+bool SmallHashMap<K, V, N, H>::has(const K& key, const size_t hash_value) const {
+  if (spilled) return spilled->has(key, hash_value);
+  return find_inline(key, hash_value) < n_inline_keys;
+}
+
+template <class K, class V, size_t N, class H>
+void SmallHashMap<K, V, N, H>::unset(const K& key, const size_t hash_value) {
+  if (spilled) {
+    spilled->unset(key, hash_value);
+    return;
+  }
+  const size_t slot = find_inline(key, hash_value);
+  if (slot == n_inline_keys) return;
+  n_inline_keys--;
+  if (slot == n_inline_keys) return;
+  keys[slot] = std::move(keys[n_inline_keys]);
+  values[slot] = std::move(values[n_inline_keys]);
+  hash_values[slot] = hash_values[n_inline_keys];
+}
+
+template <class K, class V, size_t N, class H>
+void SmallHashMap<K, V, N, H>::clear() {
+  n_inline_keys = 0;
+  spilled.reset();
+}
+
+template <class K, class V, size_t N, class H>
+template <class F>
+void SmallHashMap<K, V, N, H>::for_each(const F& handler) const {
+  if (spilled) {
+    spilled->for_each(handler);
+    return;
+  }
+  for (size_t i = 0; i < n_inline_keys; i++) handler(keys[i], hash_values[i], values[i]);
+}
+
+template <class K, class V, size_t N, class H>
+size_t SmallHashMap<K, V, N, H>::find_inline(const K& key, const size_t hash_value) const {
+  for (size_t i = 0; i < n_inline_keys; i++) {
+    if (hash_values[i] == hash_value && keys[i] == key) return i;
+  }
+  return n_inline_keys;
+}
+
+template <class K, class V, size_t N, class H>
+void SmallHashMap<K, V, N, H>::spill() {
+  spilled.reset(new HashMap<K, V, H>());
+  spilled->reserve(N * 2);
+  for (size_t i = 0; i < n_inline_keys; i++) {
+    spilled->set(std::move(keys[i]), hash_values[i], std::move(values[i]), Reducer<V>::keep);
+  }
+  n_inline_keys = 0;
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
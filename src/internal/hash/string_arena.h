@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "string_hasher.h"
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// Bump allocated bytes of the string keys of a table, addressed by offsets so that copying the
+// table copies the arena as a whole. The bytes of unset keys are reclaimed when the table
+// compacts the arena, on shrink_to_fit and erase_if, or on clear.
+class StringArena {
+ public:
+  constexpr static size_t MAX_OFFSET = (1ull << 40) - 1;
+
+  constexpr static size_t MAX_SIZE = (1ull << 24) - 1;
+
+  size_t append(const char* data, const size_t size);
+
+  const char* get_data(const size_t offset) const { return bytes.data() + offset; }
+
+  size_t get_n_bytes() const { return bytes.size(); }
+
+  void clear() { bytes.clear(); }
+
+  void shrink_to_fit() { bytes.shrink_to_fit(); }
+
+ private:
+  std::vector<char> bytes;
+};
+
+// Selects the arena storage for std::string keys when used as the hasher.
+class ArenaStringHasher : public StringHasher {};
+
+template <>
+class IsTransparentKey<ArenaStringHasher, StringView> {
+ public:
+  constexpr static bool value = true;
+};
+
+inline size_t StringArena::append(const char* data, const size_t size) {
+  const size_t offset = bytes.size();
+  if (size > MAX_SIZE || offset + size > MAX_OFFSET) {
+    throw std::length_error("String arena is full.");
+  }
+  bytes.insert(bytes.end(), data, data + size);
+  return offset;
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "../string_view.h"
+
+namespace fgpl {
+namespace internal {
+namespace hash {
+
+// Hashes std::string and StringView alike, so that string keyed containers can be probed by
+// views. Reads the bytes eight at a time with a multiply-xorshift mix per word.
+class StringHasher {
+ public:
+  size_t operator()(const std::string& key) const { return hash_bytes(key.data(), key.size()); }
+
+  size_t operator()(const StringView& key) const { return hash_bytes(key.data(), key.size()); }
+
+  static size_t hash_bytes(const char* data, size_t size);
+};
+
+// Whether the containers hashed by H accept keys of type Q in place of their own key type.
+// Specialize it for other hashers that hash Q and the key type alike.
+template <class H, class Q>
+class IsTransparentKey {
+ public:
+  constexpr static bool value = false;
+};
+
+template <>
+class IsTransparentKey<StringHasher, StringView> {
+ public:
+  constexpr static bool value = true;
+};
+
+template <class H, class Q>
+using EnableIfTransparentKey = typename std::enable_if<IsTransparentKey<H, Q>::value>::type;
+
+inline size_t StringHasher::hash_bytes(const char* data, size_t size) {
+  uint64_t hash_value = 0x9E3779B97F4A7C15ull ^ size;
+  uint64_t word;
+  while (size >= 8) {
+    std::memcpy(&word, data, 8);
+    hash_value = (hash_value ^ word) * 0xFF51AFD7ED558CCDull;
+    hash_value ^= hash_value >> 32;
+    data += 8;
+    size -= 8;
+  }
+  word = 0;
+  std::memcpy(&word, data, size);
+  hash_value = (hash_value ^ word) * 0xC4CEB9FE1A85EC53ull;
+  hash_value ^= hash_value >> 29;
+  return static_cast<size_t>(hash_value);
+}
+
+}  // namespace hash
+}  // namespace internal
+}  // namespace fgpl
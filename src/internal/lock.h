@@ -0,0 +1,311 @@
+#pragma once
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fgpl {
+namespace internal {
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// A fixed size array of default constructed elements starting on a cache line, so that elements
+// aligned to CACHE_LINE_SIZE never share cache lines, which operator new only guarantees since
+// C++17.
+template <class T>
+class CacheLineArray {
+ public:
+  CacheLineArray() : data(nullptr), n(0) {}
+
+  CacheLineArray(const CacheLineArray&) = delete;
+
+  CacheLineArray& operator=(const CacheLineArray&) = delete;
+
+  ~CacheLineArray() { reset(0); }
+
+  // Destroys the elements and constructs n new ones.
+  void reset(const size_t n);
+
+  size_t size() const { return n; }
+
+  T& operator[](const size_t i) { return data[i]; }
+
+  const T& operator[](const size_t i) const { return data[i]; }
+
+ private:
+  T* data;
+
+  size_t n;
+};
+
+// Small indices unique among the live threads of the process, from any team or from outside
+// OpenMP, and reused after the threads exit, e.g. to index per-thread slots where
+// omp_get_thread_num repeats across nested teams.
+class ThreadIndex {
+ public:
+  static size_t get() {
+    thread_local const Holder holder;
+    return holder.index;
+  }
+
+ private:
+  struct Holder {
+    size_t index;
+
+    Holder() : index(acquire()) {}
+
+    ~Holder() { release(index); }
+  };
+
+  struct Registry {
+    std::mutex mutex;
+
+    // A min heap, so that the smallest index is reused first.
+    std::vector<size_t> free_indices;
+
+    size_t n_indices = 0;
+  };
+
+  // Never destroyed, so that the threads exiting after the static destructors can still release.
+  static Registry& get_registry() {
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  static size_t acquire();
+
+  static void release(const size_t index);
+};
+
+// The lock policies of the concurrent containers. They meet the Lockable requirements, so work
+// with std::lock_guard, and are neither copyable nor movable. The containers keep each lock on
+// the cache line of the state it guards.
+
+// The lock of the OpenMP runtime.
+class OmpLock {
+ public:
+  OmpLock() { omp_init_lock(&omp_lock); }
+
+  OmpLock(const OmpLock&) = delete;
+
+  OmpLock& operator=(const OmpLock&) = delete;
+
+  ~OmpLock() { omp_destroy_lock(&omp_lock); }
+
+  void lock() { omp_set_lock(&omp_lock); }
+
+  bool try_lock() { return omp_test_lock(&omp_lock) != 0; }
+
+  void unlock() { omp_unset_lock(&omp_lock); }
+
+ private:
+  omp_lock_t omp_lock;
+};
+
+// Test and test-and-set spinlock. The cheapest under light contention, as waiting threads spin on
+// their cached copy of the flag until it is released.
+class SpinLock {
+ public:
+  SpinLock() : locked(false) {}
+
+  SpinLock(const SpinLock&) = delete;
+
+  SpinLock& operator=(const SpinLock&) = delete;
+
+  void lock();
+
+  bool try_lock() {
+    return !locked.load(std::memory_order_relaxed) &&
+           !locked.exchange(true, std::memory_order_acquire);
+  }
+
+  void unlock() { locked.store(false, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> locked;
+};
+
+// Grants the lock in the order of arrival, so no thread starves under heavy contention.
+class TicketLock {
+ public:
+  TicketLock() : next_ticket(0), serving_ticket(0) {}
+
+  TicketLock(const TicketLock&) = delete;
+
+  TicketLock& operator=(const TicketLock&) = delete;
+
+  void lock();
+
+  bool try_lock();
+
+  void unlock() {
+    serving_ticket.store(
+        serving_ticket.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint32_t> next_ticket;
+
+  std::atomic<uint32_t> serving_ticket;
+};
+
+// Sleeps in the kernel when contended instead of spinning, which suits long critical sections and
+// more threads than cores. Falls back to yielding where futexes are not available.
+class FutexLock {
+ public:
+  FutexLock() : state(UNLOCKED) {}
+
+  FutexLock(const FutexLock&) = delete;
+
+  FutexLock& operator=(const FutexLock&) = delete;
+
+  void lock();
+
+  bool try_lock() {
+    int expected = UNLOCKED;
+    return state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
+  }
+
+  void unlock() {
+    if (state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED) wake();
+  }
+
+ private:
+  constexpr static int UNLOCKED = 0;
+
+  constexpr static int LOCKED = 1;
+
+  // Locked with possible waiters to wake.
+  constexpr static int CONTENDED = 2;
+
+  std::atomic<int> state;
+
+  void wait();
+
+  void wake();
+};
+
+// Spins briefly before giving up the core, so that waiting does not starve the lock holder when
+// there are more threads than cores.
+class Backoff {
+ public:
+  Backoff() : n_spins(0) {}
+
+  void pause();
+
+ private:
+  constexpr static size_t N_MAX_SPINS = 64;
+
+  size_t n_spins;
+};
+
+template <class T>
+void CacheLineArray<T>::reset(const size_t n) {
+  for (size_t i = 0; i < this->n; i++) data[i].~T();
+  free(data);
+  data = nullptr;
+  this->n = 0;
+  if (n == 0) return;
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, CACHE_LINE_SIZE, n * sizeof(T)) != 0) throw std::bad_alloc();
+  data = static_cast<T*>(ptr);
+  for (size_t i = 0; i < n; i++) ::new (static_cast<void*>(data + i)) T();
+  this->n = n;
+}
+
+inline size_t ThreadIndex::acquire() {
+  Registry& registry = get_registry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  if (registry.free_indices.empty()) return registry.n_indices++;
+  std::pop_heap(
+      registry.free_indices.begin(), registry.free_indices.end(), std::greater<size_t>());
+  const size_t index = registry.free_indices.back();
+  registry.free_indices.pop_back();
+  return index;
+}
+
+inline void ThreadIndex::release(const size_t index) {
+  Registry& registry = get_registry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  registry.free_indices.push_back(index);
+  std::push_heap(
+      registry.free_indices.begin(), registry.free_indices.end(), std::greater<size_t>());
+}
+
+inline void Backoff::pause() {
+  if (n_spins < N_MAX_SPINS) {
+    n_spins++;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else {
+    std::this_thread::yield();
+  }
+}
+
+inline void SpinLock::lock() {
+  Backoff backoff;
+  while (locked.exchange(true, std::memory_order_acquire)) {
+    while (locked.load(std::memory_order_relaxed)) backoff.pause();
+  }
+}
+
+inline void TicketLock::lock() {
+  const uint32_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+  Backoff backoff;
+  while (serving_ticket.load(std::memory_order_acquire) != ticket) backoff.pause();
+}
+
+inline bool TicketLock::try_lock() {
+  uint32_t ticket = serving_ticket.load(std::memory_order_relaxed);
+  return next_ticket.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire);
+}
+
+inline void FutexLock::lock() {
+  int expected = UNLOCKED;
+  if (state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire)) return;
+  if (expected != CONTENDED) expected = state.exchange(CONTENDED, std::memory_order_acquire);
+  while (expected != UNLOCKED) {
+    wait();
+    expected = state.exchange(CONTENDED, std::memory_order_acquire);
+  }
+}
+
+#ifdef __linux__
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "Futexes need plain int atomics.");
+
+inline void FutexLock::wait() {
+  syscall(
+      SYS_futex,
+      reinterpret_cast<int*>(&state),
+      FUTEX_WAIT_PRIVATE,
+      CONTENDED,
+      nullptr,
+      nullptr,
+      0);
+}
+
+inline void FutexLock::wake() {
+  syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+#else
+inline void FutexLock::wait() { std::this_thread::yield(); }
+
+inline void FutexLock::wake() {}
+#endif
+
+}  // namespace internal
+}  // namespace fgpl
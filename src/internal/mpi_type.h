@@ -5,72 +5,112 @@
 namespace fgpl {
 namespace internal {
 
-template <class T>
+// The dummy parameter keeps the out-of-class definitions below header-safe.
+template <class T, class E = void>
 struct MpiType {};
 
-template <>
-struct MpiType<char> {
-  constexpr static MPI_Datatype value = MPI_CHAR;
+template <class E>
+struct MpiType<char, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<short> {
-  constexpr static MPI_Datatype value = MPI_SHORT;
+template <class E>
+const MPI_Datatype MpiType<char, E>::value = MPI_CHAR;
+
+template <class E>
+struct MpiType<short, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<int> {
-  constexpr static MPI_Datatype value = MPI_INT;
+template <class E>
+const MPI_Datatype MpiType<short, E>::value = MPI_SHORT;
+
+template <class E>
+struct MpiType<int, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<long> {
-  constexpr static MPI_Datatype value = MPI_LONG;
+template <class E>
+const MPI_Datatype MpiType<int, E>::value = MPI_INT;
+
+template <class E>
+struct MpiType<long, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<long long> {
-  constexpr static MPI_Datatype value = MPI_LONG_LONG_INT;
+template <class E>
+const MPI_Datatype MpiType<long, E>::value = MPI_LONG;
+
+template <class E>
+struct MpiType<long long, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<unsigned char> {
-  constexpr static MPI_Datatype value = MPI_UNSIGNED_CHAR;
+template <class E>
+const MPI_Datatype MpiType<long long, E>::value = MPI_LONG_LONG_INT;
+
+template <class E>
+struct MpiType<unsigned char, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<unsigned short> {
-  constexpr static MPI_Datatype value = MPI_UNSIGNED_SHORT;
+template <class E>
+const MPI_Datatype MpiType<unsigned char, E>::value = MPI_UNSIGNED_CHAR;
+
+template <class E>
+struct MpiType<unsigned short, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<unsigned> {
-  constexpr static MPI_Datatype value = MPI_UNSIGNED;
+template <class E>
+const MPI_Datatype MpiType<unsigned short, E>::value = MPI_UNSIGNED_SHORT;
+
+template <class E>
+struct MpiType<unsigned, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<unsigned long> {
-  constexpr static MPI_Datatype value = MPI_UNSIGNED_LONG;
+template <class E>
+const MPI_Datatype MpiType<unsigned, E>::value = MPI_UNSIGNED;
+
+template <class E>
+struct MpiType<unsigned long, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<unsigned long long> {
-  constexpr static MPI_Datatype value = MPI_UNSIGNED_LONG_LONG;
+template <class E>
+const MPI_Datatype MpiType<unsigned long, E>::value = MPI_UNSIGNED_LONG;
+
+template <class E>
+struct MpiType<unsigned long long, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<float> {
-  constexpr static MPI_Datatype value = MPI_FLOAT;
+template <class E>
+const MPI_Datatype MpiType<unsigned long long, E>::value = MPI_UNSIGNED_LONG_LONG;
+
+template <class E>
+struct MpiType<float, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<double> {
-  constexpr static MPI_Datatype value = MPI_DOUBLE;
+template <class E>
+const MPI_Datatype MpiType<float, E>::value = MPI_FLOAT;
+
+template <class E>
+struct MpiType<double, E> {
+  static const MPI_Datatype value;
 };
 
-template <>
-struct MpiType<long double> {
-  constexpr static MPI_Datatype value = MPI_LONG_DOUBLE;
+template <class E>
+const MPI_Datatype MpiType<double, E>::value = MPI_DOUBLE;
+
+template <class E>
+struct MpiType<long double, E> {
+  static const MPI_Datatype value;
 };
+
+template <class E>
+const MPI_Datatype MpiType<long double, E>::value = MPI_LONG_DOUBLE;
 };  // namespace internal
 };  // namespace fgpl
\ No newline at end of file
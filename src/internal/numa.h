@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fgpl {
+namespace internal {
+
+// The NUMA topology as reported by the kernel, read without libnuma. Systems that report none are
+// treated as a single node.
+class NumaTopology {
+ public:
+  // The number of node ids, i.e. one past the largest online node id.
+  static size_t get_n_nodes() {
+    static const size_t n_nodes = read_n_nodes();
+    return n_nodes;
+  }
+
+  // The node of the cpu the calling thread runs on. Only stable while the thread stays there, e.g.
+  // with OMP_PROC_BIND set.
+  static size_t get_current_node();
+
+ private:
+  static size_t read_n_nodes();
+};
+
+inline size_t NumaTopology::get_current_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < get_n_nodes()) return node;
+#endif
+  return 0;
+}
+
+// Parses the node list such as "0-1" or "0,2-3", of which the last id is the largest.
+inline size_t NumaTopology::read_n_nodes() {
+  std::ifstream file("/sys/devices/system/node/online");
+  std::string nodes;
+  if (!(file >> nodes)) return 1;
+  size_t max_node = 0;
+  bool has_node = false;
+  for (const char c : nodes) {
+    if (c >= '0' && c <= '9') {
+      if (!has_node) max_node = 0;
+      max_node = max_node * 10 + (c - '0');
+      has_node = true;
+    } else {
+      has_node = false;
+    }
+  }
+  return max_node + 1;
+}
+
+}  // namespace internal
+}  // namespace fgpl
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace fgpl {
+namespace internal {
+
+// A non-owning view of a string, for looking up string keys without constructing them.
+class StringView {
+ public:
+  StringView() : data_ptr(nullptr), n_chars(0) {}
+
+  StringView(const char* data, const size_t size) : data_ptr(data), n_chars(size) {}
+
+  StringView(const char* str) : data_ptr(str), n_chars(std::strlen(str)) {}
+
+  StringView(const std::string& str) : data_ptr(str.data()), n_chars(str.size()) {}
+
+  const char* data() const { return data_ptr; }
+
+  size_t size() const { return n_chars; }
+
+  operator std::string() const { return std::string(data_ptr, n_chars); }
+
+ private:
+  const char* data_ptr;
+
+  size_t n_chars;
+};
+
+inline bool operator==(const StringView& lhs, const StringView& rhs) {
+  return lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+inline bool operator==(const std::string& lhs, const StringView& rhs) {
+  return StringView(lhs) == rhs;
+}
+
+inline bool operator==(const StringView& lhs, const std::string& rhs) {
+  return lhs == StringView(rhs);
+}
+
+}  // namespace internal
+}  // namespace fgpl
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "internal/lock.h"
+
+namespace fgpl {
+
+using OmpLock = internal::OmpLock;
+
+using SpinLock = internal::SpinLock;
+
+using TicketLock = internal::TicketLock;
+
+using FutexLock = internal::FutexLock;
+
+}  // namespace fgpl
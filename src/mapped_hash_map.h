@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include "capacity.h"
+#include "internal/hash/mapped_hash_map.h"
+#include "probing.h"
+
+namespace fgpl {
+// Read-only lookups into a HashMap saved with save(path), without parsing or copying it.
+// The template arguments must match the ones of the saved map.
+template <
+    class K,
+    class V,
+    class H = std::hash<K>,
+    class C = PrimeCapacity,
+    class P = LinearProbing>
+class MappedHashMap : public internal::hash::MappedHashMap<K, V, H, C, P> {
+ public:
+  explicit MappedHashMap(const std::string& path)
+      : internal::hash::MappedHashMap<K, V, H, C, P>(path) {}
+
+  V get(const K& key, const V& default_value = V()) const {
+    return internal::hash::MappedHashMap<K, V, H, C, P>::get(key, hasher(key), default_value);
+  }
+
+  bool has(const K& key) const {
+    return internal::hash::MappedHashMap<K, V, H, C, P>::has(key, hasher(key));
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  V get(const Q& key, const V& default_value = V()) const {
+    return internal::hash::MappedHashMap<K, V, H, C, P>::get(key, hasher(key), default_value);
+  }
+
+  template <class Q, class = internal::hash::EnableIfTransparentKey<H, Q>>
+  bool has(const Q& key) const {
+    return internal::hash::MappedHashMap<K, V, H, C, P>::has(key, hasher(key));
+  }
+
+ private:
+  using internal::hash::MappedHashMap<K, V, H, C, P>::hasher;
+
+  using internal::hash::MappedHashMap<K, V, H, C, P>::get;
+
+  using internal::hash::MappedHashMap<K, V, H, C, P>::has;
+};
+}  // namespace fgpl
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "internal/hash/probing.h"
+
+namespace fgpl {
+
+using LinearProbing = internal::hash::LinearProbing;
+
+using RobinHoodProbing = internal::hash::RobinHoodProbing;
+
+}  // namespace fgpl
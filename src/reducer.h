@@ -4,21 +4,63 @@
 
 namespace fgpl {
 
+// The reducers are function objects rather than functions so that the set paths, which take the
+// reducer as a template parameter, can inline them.
 template <class T>
 class Reducer {
  public:
-  static void keep(T&, const T&) {}
+  class Keep {
+   public:
+    void operator()(T&, const T&) const {}
+  };
 
-  static void overwrite(T& t1, const T& t2) { t1 = t2; }
+  class Overwrite {
+   public:
+    void operator()(T& t1, const T& t2) const { t1 = t2; }
+  };
 
-  static void sum(T& t1, const T& t2) { t1 += t2; }
+  class Sum {
+   public:
+    void operator()(T& t1, const T& t2) const { t1 += t2; }
+  };
 
-  static void min(T& t1, const T& t2) {
-    if (t1 < t2) t1 = t2;
-  }
+  class Min {
+   public:
+    void operator()(T& t1, const T& t2) const {
+      if (t1 < t2) t1 = t2;
+    }
+  };
 
-  static void max(T& t1, const T& t2) {
-    if (t1 > t2) t1 = t2;
-  }
+  class Max {
+   public:
+    void operator()(T& t1, const T& t2) const {
+      if (t1 > t2) t1 = t2;
+    }
+  };
+
+  constexpr static Keep keep = Keep();
+
+  constexpr static Overwrite overwrite = Overwrite();
+
+  constexpr static Sum sum = Sum();
+
+  constexpr static Min min = Min();
+
+  constexpr static Max max = Max();
 };
+
+template <class T>
+constexpr typename Reducer<T>::Keep Reducer<T>::keep;
+
+template <class T>
+constexpr typename Reducer<T>::Overwrite Reducer<T>::overwrite;
+
+template <class T>
+constexpr typename Reducer<T>::Sum Reducer<T>::sum;
+
+template <class T>
+constexpr typename Reducer<T>::Min Reducer<T>::min;
+
+template <class T>
+constexpr typename Reducer<T>::Max Reducer<T>::max;
 }  // namespace fgpl
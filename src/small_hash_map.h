@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include "internal/hash/small_hash_map.h"
+#include "reducer.h"
+
+namespace fgpl {
+// For many short-lived maps with few keys, such as the per-task aggregation in a mapper before
+// emitting. Up to N entries are kept inline, after which they move to a heap HashMap.
+template <class K, class V, size_t N = 16, class H = std::hash<K>>
+class SmallHashMap : public internal::hash::SmallHashMap<K, V, N, H> {
+ public:
+  void set(const K& key, const V& value) { set(key, value, Reducer<V>::overwrite); }
+
+  // Accepts any callable reducer, including std::function.
+  template <class R>
+  void set(const K& key, const V& value, const R& reducer) {
+    internal::hash::SmallHashMap<K, V, N, H>::set(key, hasher(key), value, reducer);
+  }
+
+  V get(const K& key, const V& default_value = V()) const {
+    return internal::hash::SmallHashMap<K, V, N, H>::get(key, hasher(key), default_value);
+  }
+
+  bool has(const K& key) const {
+    return internal::hash::SmallHashMap<K, V, N, H>::has(key, hasher(key));
+  }
+
+  void unset(const K& key) { internal::hash::SmallHashMap<K, V, N, H>::unset(key, hasher(key)); }
+
+ private:
+  using internal::hash::SmallHashMap<K, V, N, H>::hasher;
+
+  using internal::hash::SmallHashMap<K, V, N, H>::set;
+
+  using internal::hash::SmallHashMap<K, V, N, H>::get;
+
+  using internal::hash::SmallHashMap<K, V, N, H>::has;
+
+  using internal::hash::SmallHashMap<K, V, N, H>::unset;
+};
+}  // namespace fgpl
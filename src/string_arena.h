@@ -0,0 +1,10 @@
+#pragma once
+
+#include "internal/hash/string_arena.h"
+
+namespace fgpl {
+
+// Use as the hasher of std::string keys to store the keys in a per-table arena.
+using ArenaStringHasher = internal::hash::ArenaStringHasher;
+
+}  // namespace fgpl
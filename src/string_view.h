@@ -0,0 +1,13 @@
+#pragma once
+
+#include "internal/hash/string_hasher.h"
+#include "internal/string_view.h"
+
+namespace fgpl {
+
+using StringView = internal::StringView;
+
+// Use as the hasher of std::string keys to look up and update them by StringView.
+using StringHasher = internal::hash::StringHasher;
+
+}  // namespace fgpl
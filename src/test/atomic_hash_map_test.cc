@@ -0,0 +1,105 @@
+#include "../atomic_hash_map.h"
+
+#include <gtest/gtest.h>
+#include <omp.h>
+#include <limits>
+#include <unordered_map>
+
+TEST(AtomicHashMapTest, Initialization) {
+  fgpl::AtomicHashMap<long long, long long> m;
+  EXPECT_EQ(m.get_n_keys(), 0);
+  EXPECT_FALSE(m.has(0));
+  EXPECT_EQ(m.get(0, -1), -1);
+}
+
+TEST(AtomicHashMapTest, SetAndGet) {
+  fgpl::AtomicHashMap<int, double> m;
+  m.set(1, 1.5);
+  m.set(2, 2.5);
+  m.set(1, 3.0, fgpl::Reducer<double>::sum);
+  m.set(2, 9.0, fgpl::Reducer<double>::keep);
+  EXPECT_EQ(m.get_n_keys(), 2);
+  EXPECT_EQ(m.get(1), 4.5);
+  EXPECT_EQ(m.get(2), 2.5);
+  EXPECT_FALSE(m.has(3));
+}
+
+TEST(AtomicHashMapTest, ParallelSumCounts) {
+  fgpl::AtomicHashMap<long long, long long> m;
+  constexpr long long N_KEYS = 10000;
+  constexpr long long N_REPEATS = 20;
+  m.reserve(N_KEYS);
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS * N_REPEATS; i++) {
+    m.set(i % N_KEYS, 1, fgpl::Reducer<long long>::sum);
+  }
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  EXPECT_EQ(m.get_n_overflow_keys(), 0);
+  for (long long i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i), N_REPEATS);
+  long long sum = 0;
+  m.for_each([&](const long long, const size_t, const long long count) {
+#pragma omp atomic
+    sum += count;
+  });
+  EXPECT_EQ(sum, N_KEYS * N_REPEATS);
+}
+
+TEST(AtomicHashMapTest, ParallelReducersWithCompareAndSwap) {
+  fgpl::AtomicHashMap<int, double> m;
+  constexpr int N_KEYS = 1000;
+  m.reserve(N_KEYS);
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS * 10; i++) {
+    m.set(i % N_KEYS, 0.5, fgpl::Reducer<double>::sum);
+    m.set(-1 - i % N_KEYS, i, [](double& v1, const double& v2) { v1 = v1 > v2 ? v1 : v2; });
+  }
+  for (int i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(m.get(i), 5.0);
+    EXPECT_EQ(m.get(-1 - i), i + N_KEYS * 9);
+  }
+}
+
+TEST(AtomicHashMapTest, OverflowAndReserve) {
+  fgpl::AtomicHashMap<int, int> m;
+  constexpr int N_KEYS = 10000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS; i++) m.set(i, i);
+  m.set(std::numeric_limits<int>::max(), 1);
+  m.set(std::numeric_limits<int>::max() - 1, 2);
+  EXPECT_GT(m.get_n_overflow_keys(), 0);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS + 2);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i), i);
+  m.reserve(N_KEYS + 2);
+  EXPECT_EQ(m.get_n_overflow_keys(), 2);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS + 2);
+  std::unordered_map<int, int> entries;
+  m.for_each_serial([&](const int key, const size_t, const int value) { entries[key] = value; });
+  EXPECT_EQ(entries.size(), N_KEYS + 2);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(entries[i], i);
+  EXPECT_EQ(m.get(std::numeric_limits<int>::max()), 1);
+  EXPECT_EQ(m.get(std::numeric_limits<int>::max() - 1), 2);
+  const auto copy = m;
+  m.clear();
+  EXPECT_EQ(m.get_n_keys(), 0);
+  EXPECT_EQ(copy.get(N_KEYS - 1), N_KEYS - 1);
+}
+
+TEST(AtomicHashMapTest, FullBeyondMaxLoadFactor) {
+  fgpl::AtomicHashMap<int, int> m;
+  constexpr int N_KEYS = 1000;
+  m.reserve(N_KEYS);
+  EXPECT_FALSE(m.is_full());
+  const size_t n_buckets = m.get_n_buckets();
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS * 4; i++) m.set(i % (N_KEYS * 2), 1, fgpl::Reducer<int>::sum);
+  EXPECT_TRUE(m.is_full());
+  EXPECT_EQ(m.get_n_buckets(), n_buckets);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS * 2);
+  EXPECT_LE(m.get_n_keys() - m.get_n_overflow_keys(), n_buckets * m.max_load_factor);
+  for (int i = 0; i < N_KEYS * 2; i++) EXPECT_EQ(m.get(i), 2);
+  EXPECT_FALSE(m.has(N_KEYS * 2));
+  m.reserve(N_KEYS * 2);
+  EXPECT_FALSE(m.is_full());
+  EXPECT_EQ(m.get_n_overflow_keys(), 0);
+  for (int i = 0; i < N_KEYS * 2; i++) EXPECT_EQ(m.get(i), 2);
+}
@@ -1,10 +1,17 @@
 #include "../concurrent_hash_map.h"
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 #include "../../vendor/hps/src/hps.h"
+#include "../allocator.h"
 #include "../hash_map.h"
+#include "../string_arena.h"
 
 TEST(ConcurrentHashMapTest, Initialization) {
   fgpl::ConcurrentHashMap<std::string, int> m;
@@ -29,6 +36,29 @@ TEST(ConcurrentHashMapTest, CopyConstructor) {
   EXPECT_TRUE(m2.has("bb"));
 }
 
+TEST(ConcurrentHashMapTest, LargeCopyConstructor) {
+  fgpl::ConcurrentHashMap<long long, long long> m;
+  constexpr long long N_KEYS = 100000;
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  fgpl::ConcurrentHashMap<long long, long long> m2(m);
+  m.clear_and_shrink();
+  EXPECT_EQ(m2.get_n_keys(), N_KEYS);
+  for (long long i = 0; i < N_KEYS; i++) EXPECT_EQ(m2.get(i * i, -1), i);
+}
+
+TEST(ConcurrentHashMapTest, ConstructInParallelRegion) {
+  long long n_keys = 0;
+#pragma omp parallel reduction(+ : n_keys)
+  {
+    fgpl::ConcurrentHashMap<int, int> m;
+    m.reserve(1000);
+    for (int i = 0; i < 1000; i++) m.set(i, i);
+    n_keys += m.get_n_keys();
+  }
+  EXPECT_EQ(n_keys, 1000LL * omp_get_max_threads());
+}
+
 TEST(ConcurrentHashMapTest, LargeReserve) {
   fgpl::ConcurrentHashMap<std::string, int> m;
   const size_t LARGE_N_BUCKETS = 1000000;
@@ -48,6 +78,109 @@ TEST(ConcurrentHashMapTest, GetAndSetLoadFactor) {
   EXPECT_GE(m.get_n_buckets(), N_KEYS / 0.5);
 }
 
+TEST(ConcurrentHashMapTest, GetManyAndHasMany) {
+  fgpl::ConcurrentHashMap<int, int> m;
+  constexpr int N_KEYS = 1000;
+  for (int i = 0; i < N_KEYS; i += 2) m.set(i, i * 3);
+  std::vector<int> keys(N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) keys[i] = i;
+  std::vector<int> values(N_KEYS);
+  m.get_many(keys.data(), N_KEYS, values.data(), -1);
+  bool found[N_KEYS];
+  m.has_many(keys.data(), N_KEYS, found);
+  for (int i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(values[i], i % 2 == 0 ? i * 3 : -1);
+    EXPECT_EQ(found[i], i % 2 == 0);
+  }
+}
+
+TEST(ConcurrentHashMapTest, IncrementalRehash) {
+  fgpl::ConcurrentHashMap<int, int> m;
+  m.set_incremental_rehash(true);
+  EXPECT_TRUE(m.get_incremental_rehash());
+  constexpr int N_KEYS = 10000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS; i++) m.set(i, i);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i, std::hash<int>()(i), -1), i);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+}
+
+TEST(ConcurrentHashMapTest, UpdateAndFind) {
+  fgpl::ConcurrentHashMap<int, std::vector<int>> m;
+  constexpr int N_KEYS = 1000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS * 4; i++) {
+    m.update(i % N_KEYS, [&](std::vector<int>& values) { values.push_back(i); });
+  }
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) {
+    const std::vector<int>* values = m.find(i);
+    ASSERT_NE(values, nullptr);
+    EXPECT_EQ(values->size(), 4);
+  }
+  EXPECT_EQ(m.find(N_KEYS), nullptr);
+  EXPECT_FALSE(m.update(0, [](std::vector<int>& values) { values.clear(); }));
+  EXPECT_TRUE(m.find(0)->empty());
+}
+
+TEST(ConcurrentHashMapTest, PoolAllocatorAsyncSetAndSync) {
+  fgpl::ConcurrentHashMap<int, int, std::hash<int>, fgpl::PoolAllocator> m;
+  constexpr int N_KEYS = 10000;
+  for (int round = 0; round < 3; round++) {
+#pragma omp parallel for
+    for (int i = 0; i < N_KEYS; i++) m.async_set(i, 1, fgpl::Reducer<int>::sum);
+    m.sync(fgpl::Reducer<int>::sum);
+  }
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(*m.find(i), 3);
+}
+
+TEST(ConcurrentHashMapTest, SegmentIterators) {
+  fgpl::ConcurrentHashMap<int, int> m;
+  constexpr int N_KEYS = 10000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS; i++) m.set(i, i);
+  long long sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+  for (size_t segment_id = 0; segment_id < m.get_n_segments(); segment_id++) {
+    for (auto it = m.segment_begin(segment_id); it != m.segment_end(segment_id); ++it) {
+      sum += it->get_value();
+    }
+  }
+  EXPECT_EQ(sum, static_cast<long long>(N_KEYS) * (N_KEYS - 1) / 2);
+  int n_keys = 0;
+  for (const auto& entry : m) {
+    EXPECT_EQ(entry.get_key(), entry.get_value());
+    n_keys++;
+  }
+  EXPECT_EQ(n_keys, N_KEYS);
+  sum = 0;
+  m.for_each_serial([&](const int, const size_t, const int value) { sum += value; });
+  EXPECT_EQ(sum, static_cast<long long>(N_KEYS) * (N_KEYS - 1) / 2);
+}
+
+TEST(ConcurrentHashMapTest, ParallelEraseIfAndShrink) {
+  fgpl::ConcurrentHashMap<int, int> m;
+  constexpr int N_KEYS = 100000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS; i++) m.async_set(i, i % 10);
+  m.sync();
+  const size_t n_buckets = m.get_n_buckets();
+  m.set_min_load_factor(0.15f);
+  const size_t n_erased = m.erase_if([](const int, const size_t, const int count) {
+    return count < 5;
+  });
+  EXPECT_EQ(n_erased, N_KEYS / 2);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS / 2);
+  EXPECT_EQ(m.get_n_buckets(), n_buckets);
+  m.retain([](const int, const size_t, const int count) { return count == 9; });
+  EXPECT_EQ(m.get_n_keys(), N_KEYS / 10);
+  EXPECT_LT(m.get_n_buckets(), n_buckets / 2);
+  for (int i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(m.get(i, std::hash<int>()(i), -1), i % 10 == 9 ? 9 : -1);
+  }
+}
+
 TEST(ConcurrentHashMapTest, SetAndGet) {
   fgpl::ConcurrentHashMap<std::string, int> m;
   m.set("aa", 1);
@@ -119,6 +252,144 @@ TEST(ConcurrentHashMapTest, LargeParallelAsyncSet) {
   EXPECT_GE(m.get_n_buckets(), N_KEYS);
 }
 
+TEST(ConcurrentHashMapTest, LargeParallelSetAndGet) {
+  fgpl::ConcurrentHashMap<long long, long long> m;
+  constexpr long long N_KEYS = 1000000;
+  long long n_wrong_values = 0;
+#pragma omp parallel for reduction(+ : n_wrong_values)
+  for (long long i = 0; i < N_KEYS; i++) {
+    m.set(i * i, i);
+    if (m.get(i * i, -1) != i) n_wrong_values++;
+    const long long j = i / 2;
+    const long long value = m.get(j * j, -1);
+    if (value != -1 && value != j) n_wrong_values++;
+    if (m.has(j * j) != (value == j) && value == j) n_wrong_values++;
+  }
+  EXPECT_EQ(n_wrong_values, 0);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+}
+
+TEST(ConcurrentHashMapTest, LargeParallelSetWithSpinLock) {
+  fgpl::ConcurrentHashMap<int, long long, std::hash<int>, std::allocator, fgpl::SpinLock> m;
+  constexpr long long N_KEYS = 1000000;
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) {
+    m.set(static_cast<int>(i % 1000), 1, fgpl::Reducer<long long>::sum);
+  }
+  EXPECT_EQ(m.get_n_keys(), 1000);
+  for (int i = 0; i < 1000; i++) EXPECT_EQ(m.get(i), N_KEYS / 1000);
+}
+
+TEST(ConcurrentHashMapTest, SetNSegments) {
+  fgpl::ConcurrentHashMap<std::string, int> m;
+  constexpr int N_KEYS = 10000;
+  for (int i = 0; i < N_KEYS; i++) m.set(std::to_string(i), i);
+  m.set_n_segments(7);
+  EXPECT_EQ(m.get_n_segments(), 7);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(std::to_string(i), -1), i);
+  m.set_n_segments(64);
+  m.set("a", 1);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS + 1);
+  EXPECT_EQ(m.get("9999"), 9999);
+  EXPECT_THROW(m.set_n_segments(0), std::invalid_argument);
+}
+
+TEST(ConcurrentHashMapTest, SyncAddsSegmentsWhenContended) {
+  fgpl::ConcurrentHashMap<long long, long long> m;
+  const size_t n_segments = m.get_n_segments();
+  // Re-segments on any contention, even none.
+  m.set_max_contention(0.0f);
+  constexpr long long N_KEYS = 100000;
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) m.async_set(i * i, i);
+  EXPECT_GE(m.get_contention(), 0.0f);
+  EXPECT_LE(m.get_contention(), 1.0f);
+  m.sync();
+  EXPECT_EQ(m.get_n_segments(), n_segments * 4);
+  EXPECT_EQ(m.get_contention(), 0.0f);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (long long i = 0; i < N_KEYS; i += 7) EXPECT_EQ(m.get(i * i, -1), i);
+
+  m.set_max_contention(2.0f);
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) m.async_set(i * i, i + 1);
+  m.sync();
+  EXPECT_EQ(m.get_n_segments(), n_segments * 4);
+  EXPECT_EQ(m.get(49, -1), 8);
+}
+
+TEST(ConcurrentHashMapTest, GetFromOtherThreadsDuringSet) {
+  fgpl::ConcurrentHashMap<long long, long long> m;
+  constexpr long long N_KEYS = 200000;
+  std::atomic<bool> done(false);
+  std::atomic<long long> n_wrong_values(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      while (!done) {
+        for (long long j = 0; j < N_KEYS; j += 97) {
+          const long long value = m.get(j * j, -1);
+          if (value != -1 && value != j) n_wrong_values++;
+        }
+      }
+    });
+  }
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  done = true;
+  for (auto& reader : readers) reader.join();
+  EXPECT_EQ(n_wrong_values, 0);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+}
+
+TEST(ConcurrentHashMapTest, GetManyFromOtherThreadsDuringSet) {
+  fgpl::ConcurrentHashMap<long long, long long> m;
+  constexpr long long N_KEYS = 200000;
+  constexpr size_t N_BATCH_KEYS = 1000;
+  std::atomic<bool> done(false);
+  std::atomic<long long> n_wrong_values(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      std::vector<long long> keys(N_BATCH_KEYS);
+      std::vector<long long> values(N_BATCH_KEYS);
+      std::unique_ptr<bool[]> found(new bool[N_BATCH_KEYS]);
+      for (size_t j = 0; j < N_BATCH_KEYS; j++) keys[j] = (j * 197) * (j * 197);
+      while (!done) {
+        m.get_many(keys.data(), N_BATCH_KEYS, values.data(), -1);
+        m.has_many(keys.data(), N_BATCH_KEYS, found.get());
+        for (size_t j = 0; j < N_BATCH_KEYS; j++) {
+          if (values[j] != -1 && values[j] != static_cast<long long>(j * 197)) n_wrong_values++;
+        }
+      }
+    });
+  }
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  done = true;
+  for (auto& reader : readers) reader.join();
+  EXPECT_EQ(n_wrong_values, 0);
+  std::vector<long long> keys(N_BATCH_KEYS);
+  std::unique_ptr<bool[]> found(new bool[N_BATCH_KEYS]);
+  for (size_t j = 0; j < N_BATCH_KEYS; j++) keys[j] = (j * 197) * (j * 197);
+  m.has_many(keys.data(), N_BATCH_KEYS, found.get());
+  for (size_t j = 0; j < N_BATCH_KEYS; j++) EXPECT_TRUE(found[j]);
+}
+
+TEST(ConcurrentHashMapTest, CopyAssignment) {
+  fgpl::ConcurrentHashMap<long long, long long> m;
+  for (long long i = 0; i < 1000; i++) m.set(i, i * 2);
+  fgpl::ConcurrentHashMap<long long, long long> m2;
+  m2.set(-1, 0);
+  m2 = m;
+  for (long long i = 0; i < 1000; i++) m2.set(i + 1000, i);
+  EXPECT_EQ(m2.get_n_keys(), 2000);
+  EXPECT_EQ(m2.get(999), 1998);
+  EXPECT_FALSE(m2.has(-1));
+  EXPECT_EQ(m.get_n_keys(), 1000);
+}
+
 TEST(ConcurrentHashMapTest, UnsetAndHas) {
   fgpl::ConcurrentHashMap<std::string, int> m;
   m.set("aa", 1);
@@ -161,6 +432,23 @@ TEST(ConcurrentHashMapTest, ClearAndShrink) {
   EXPECT_LT(m.get_n_buckets(), N_KEYS * m.get_max_load_factor());
 }
 
+TEST(ConcurrentHashMapTest, ArenaStringKeysSerializeAndParse) {
+  fgpl::ConcurrentHashMap<std::string, int, fgpl::ArenaStringHasher> m;
+#pragma omp parallel for
+  for (int i = 0; i < 1000; i++) m.async_set(std::to_string(i % 100), 1, fgpl::Reducer<int>::sum);
+  m.sync(fgpl::Reducer<int>::sum);
+  const auto& serialized = hps::to_string(m);
+  auto parsed =
+      hps::from_string<fgpl::ConcurrentHashMap<std::string, int, fgpl::ArenaStringHasher>>(
+          serialized);
+  EXPECT_EQ(parsed.get_n_keys(), 100);
+  const fgpl::ArenaStringHasher hasher;
+  for (int i = 0; i < 100; i++) {
+    const std::string key = std::to_string(i);
+    EXPECT_EQ(parsed.get(key, hasher(key), 0), 10);
+  }
+}
+
 TEST(ConcurrentHashMapTest, SerializeAndParse) {
   fgpl::ConcurrentHashMap<long long, long long> m;
   m.set(0, 0);
@@ -171,3 +459,21 @@ TEST(ConcurrentHashMapTest, SerializeAndParse) {
   EXPECT_TRUE(parsed.has(0));
   EXPECT_TRUE(parsed.has(1));
 }
+
+TEST(ConcurrentHashMapTest, LargeTriviallyCopyableSerializeAndParse) {
+  fgpl::ConcurrentHashMap<long long, double> m;
+  constexpr long long N_KEYS = 100000;
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) m.async_set(i * i, i * 0.5);
+  m.sync();
+  const auto& serialized = hps::to_string(m);
+  // Only the keys and values go on the wire, with a few bytes of counts per segment.
+  EXPECT_LT(serialized.size(), N_KEYS * (sizeof(long long) + sizeof(double)) + 10000);
+  auto parsed = hps::from_string<fgpl::ConcurrentHashMap<long long, double>>(serialized);
+  EXPECT_EQ(parsed.get_n_keys(), N_KEYS);
+  for (long long i = 0; i < N_KEYS; i++) {
+    const long long key = i * i;
+    EXPECT_EQ(parsed.get(key, std::hash<long long>()(key), -1.0), i * 0.5);
+  }
+  EXPECT_FALSE(parsed.has(2));
+}
@@ -119,6 +119,29 @@ TEST(ConcurrentHashSetTest, LargeParallelAsyncSet) {
   EXPECT_GE(m.get_n_buckets(), N_KEYS);
 }
 
+TEST(ConcurrentHashSetTest, LargeParallelAsyncSetWithTicketLock) {
+  fgpl::ConcurrentHashSet<long long, std::hash<long long>, std::allocator, fgpl::TicketLock> m;
+  constexpr long long N_KEYS = 1000000;
+#pragma omp parallel for
+  for (long long i = 0; i < N_KEYS; i++) {
+    m.async_set(i * i);
+  }
+  m.sync();
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  EXPECT_TRUE(m.has(999 * 999));
+}
+
+TEST(ConcurrentHashSetTest, SetNSegments) {
+  fgpl::ConcurrentHashSet<int> m;
+  constexpr int N_KEYS = 10000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS; i++) m.set(i * 3);
+  m.set_n_segments(5);
+  EXPECT_EQ(m.get_n_segments(), 5);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (int i = 0; i < N_KEYS * 3; i++) EXPECT_EQ(m.has(i), i % 3 == 0);
+}
+
 TEST(ConcurrentHashSetTest, UnsetAndHas) {
   fgpl::ConcurrentHashSet<std::string> m;
   m.set("aa");
@@ -14,3 +14,12 @@ TEST(ConcurrentVectorTest, ResizeAndForEach) {
   vec.for_each_serial([&](const size_t, const double value) { sum += value; });
   EXPECT_NEAR(sum, 11.0, 1.0e-10);
 }
+
+TEST(ConcurrentVectorTest, ParallelSetWithFutexLock) {
+  fgpl::ConcurrentVector<long long, fgpl::FutexLock> vec;
+  constexpr long long N = 100;
+  vec.resize(N);
+#pragma omp parallel for
+  for (long long i = 0; i < N * 1000; i++) vec.set(i % N, 1, fgpl::Reducer<long long>::sum);
+  vec.for_each_serial([&](const size_t, const long long value) { EXPECT_EQ(value, 1000); });
+}
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <iostream>
 #include "../dist_range.h"
+#include "../string_view.h"
 
 TEST(DistHashMapTest, AsyncSetAndSyncTest) {
   const long long N_KEYS = 100;
@@ -33,6 +34,40 @@ TEST(DistHashMapTest, ForEach) {
   EXPECT_EQ(sum_global, N_KEYS * (N_KEYS - 1) * (2 * N_KEYS - 1) / 6);
 }
 
+TEST(DistHashMapTest, EraseIfAndRetain) {
+  const long long N_KEYS = 100;
+  fgpl::DistHashMap<long long, long long> ds;
+  fgpl::DistRange<long long> range(0, N_KEYS);
+  range.for_each([&](const long long i) { ds.async_set(i, i); });
+  ds.sync();
+  const auto& is_small = [](const long long, const size_t, const long long i) { return i < 50; };
+  EXPECT_EQ(ds.erase_if(is_small), 50);
+  EXPECT_EQ(ds.retain([](const long long, const size_t, const long long i) { return i < 60; }), 40);
+  EXPECT_EQ(ds.get_n_keys(), 10);
+}
+
+TEST(DistHashMapTest, AsyncSetByStringView) {
+  const std::string text = "to be or not to be";
+  fgpl::DistHashMap<std::string, int, fgpl::StringHasher> dm;
+  fgpl::DistRange<int> range(0, 10);
+  range.for_each([&](const int) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+      size_t end = text.find(' ', begin);
+      if (end == std::string::npos) end = text.size();
+      dm.async_set(fgpl::StringView(text.data() + begin, end - begin), 1, fgpl::Reducer<int>::sum);
+      begin = end + 1;
+    }
+  });
+  dm.sync(fgpl::Reducer<int>::sum);
+  EXPECT_EQ(dm.get_n_keys(), 4);
+  int n_words = 0;
+  dm.for_each_serial([&](const std::string&, const size_t, const int count) { n_words += count; });
+  int n_words_global = 0;
+  MPI_Allreduce(&n_words, &n_words_global, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  EXPECT_EQ(n_words_global, 60);
+}
+
 TEST(DistHashMapTest, Mapreduce) {
   const long long N_KEYS = 100;
   fgpl::DistHashMap<long long, long long> ds;
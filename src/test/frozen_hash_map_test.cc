@@ -0,0 +1,79 @@
+#include "../frozen_hash_map.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include "../concurrent_hash_map.h"
+#include "../dist_hash_map.h"
+#include "../dist_range.h"
+#include "../hash_map.h"
+#include "../string_view.h"
+
+TEST(FrozenHashMapTest, Empty) {
+  fgpl::FrozenHashMap<int, int> frozen = fgpl::HashMap<int, int>().freeze();
+  EXPECT_EQ(frozen.get_n_keys(), 0);
+  EXPECT_FALSE(frozen.has(0));
+  EXPECT_EQ(frozen.get(0, -1), -1);
+}
+
+TEST(FrozenHashMapTest, FreezeHashMap) {
+  fgpl::HashMap<long long, double> m;
+  constexpr long long N_KEYS = 100000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  const auto& frozen = m.freeze();
+  EXPECT_EQ(frozen.get_n_keys(), N_KEYS);
+  EXPECT_LT(frozen.get_n_bytes(), m.get_n_buckets() * (sizeof(long long) + sizeof(double)));
+  for (long long i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(frozen.get(i * i), i);
+    EXPECT_EQ(*frozen.find(i * i), i);
+  }
+  EXPECT_FALSE(frozen.has(2));
+  EXPECT_EQ(frozen.find(3), nullptr);
+  double sum = 0.0;
+  frozen.for_each([&](const long long key, const size_t hash_value, const double value) {
+    EXPECT_EQ(hash_value, std::hash<long long>()(key));
+    sum += value;
+  });
+  EXPECT_EQ(sum, static_cast<double>(N_KEYS) * (N_KEYS - 1) / 2);
+}
+
+TEST(FrozenHashMapTest, FreezeConcurrentHashMapAndParallelGet) {
+  fgpl::ConcurrentHashMap<int, int> m;
+  constexpr int N_KEYS = 100000;
+#pragma omp parallel for
+  for (int i = 0; i < N_KEYS; i++) m.async_set(i, i * 3);
+  m.sync();
+  const auto& frozen = m.freeze();
+  EXPECT_EQ(frozen.get_n_keys(), N_KEYS);
+  int n_errors = 0;
+#pragma omp parallel for reduction(+ : n_errors)
+  for (int i = 0; i < N_KEYS * 2; i++) n_errors += frozen.get(i, -1) != (i < N_KEYS ? i * 3 : -1);
+  EXPECT_EQ(n_errors, 0);
+}
+
+TEST(FrozenHashMapTest, StringViewLookups) {
+  fgpl::HashMap<std::string, int, fgpl::StringHasher> m;
+  for (int i = 0; i < 1000; i++) m.set("key" + std::to_string(i), i);
+  const auto& frozen = m.freeze();
+  const char text[] = "key12x";
+  EXPECT_EQ(frozen.get(fgpl::StringView(text, 5)), 12);
+  EXPECT_FALSE(frozen.has(fgpl::StringView(text, 6)));
+  EXPECT_EQ(frozen.get("key999"), 999);
+}
+
+TEST(FrozenHashMapTest, FreezeDistHashMapLocal) {
+  fgpl::DistHashMap<int, int> dm;
+  fgpl::DistRange<int> range(0, 1000);
+  range.for_each([&](const int i) { dm.async_set(i, i); });
+  dm.sync();
+  const auto& frozen = dm.freeze_local();
+  size_t n_local_keys = 0;
+  for (int i = 0; i < 1000; i++) {
+    if (!frozen.has(i)) continue;
+    EXPECT_EQ(frozen.get(i), dm.get_local(i, -1));
+    n_local_keys++;
+  }
+  EXPECT_EQ(n_local_keys, frozen.get_n_keys());
+  size_t n_keys = 0;
+  MPI_Allreduce(&n_local_keys, &n_keys, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+  EXPECT_EQ(n_keys, 1000);
+}
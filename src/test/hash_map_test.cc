@@ -1,8 +1,14 @@
 #include "../hash_map.h"
+#include "../allocator.h"
+#include "../string_arena.h"
+#include "../string_view.h"
 
 #include <gtest/gtest.h>
+#include <omp.h>
+#include <iterator>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 TEST(HashMapTest, Initialization) {
   fgpl::HashMap<std::string, int> m;
@@ -21,6 +27,232 @@ TEST(HashMapTest, SetGetAndCopyConstructor) {
   EXPECT_EQ(m2.get("bb"), 2);
 }
 
+TEST(HashMapTest, SetWithReducers) {
+  fgpl::HashMap<std::string, int> m;
+  m.set("aa", 1, fgpl::Reducer<int>::sum);
+  m.set("aa", 2, fgpl::Reducer<int>::sum);
+  EXPECT_EQ(m.get("aa"), 3);
+  m.set("aa", 5, [](int& a, const int& b) { a *= b; });
+  EXPECT_EQ(m.get("aa"), 15);
+  const std::function<void(int&, const int&)> keep = fgpl::Reducer<int>::keep;
+  m.set("aa", 7, keep);
+  EXPECT_EQ(m.get("aa"), 15);
+}
+
+TEST(HashMapTest, MoveSetEmplaceAndTryEmplace) {
+  fgpl::HashMap<std::string, std::vector<double>> m;
+  std::string key = "aa";
+  std::vector<double> value(3, 1.0);
+  m.set(std::move(key), std::move(value));
+  EXPECT_EQ(m.get("aa").size(), 3);
+  m.emplace("bb", 2, 0.5);
+  EXPECT_EQ(m.get("bb"), std::vector<double>(2, 0.5));
+  m.emplace("bb", 4, 0.5);
+  EXPECT_EQ(m.get("bb").size(), 4);
+  EXPECT_FALSE(m.try_emplace("bb", 1, 0.0));
+  EXPECT_EQ(m.get("bb").size(), 4);
+  EXPECT_TRUE(m.try_emplace("cc", 1, 0.0));
+  EXPECT_EQ(m.get("cc").size(), 1);
+  const auto& append = [](std::vector<double>& v) { v.push_back(1.0); };
+  const auto& create = [](std::vector<double>& v) { v.assign(1, 2.0); };
+  EXPECT_FALSE(m.upsert("cc", append, create));
+  EXPECT_TRUE(m.upsert("dd", append, create));
+  EXPECT_EQ(m.get("cc").size(), 2);
+  EXPECT_EQ(m.get("dd"), std::vector<double>(1, 2.0));
+  for (int i = 0; i < 1000; i++) m.emplace(std::to_string(i), i, 1.0);
+  for (int i = 0; i < 1000; i++) EXPECT_EQ(m.get(std::to_string(i)).size(), i);
+  EXPECT_EQ(m.get("bb").size(), 4);
+}
+
+TEST(HashMapTest, FindAndGetOrInsert) {
+  fgpl::HashMap<int, std::vector<int>> m;
+  EXPECT_EQ(m.find(1), nullptr);
+  constexpr int N_KEYS = 1000;
+  for (int i = 0; i < N_KEYS * 3; i++) m.get_or_insert(i % N_KEYS).push_back(i);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) {
+    const std::vector<int>* values = m.find(i);
+    ASSERT_NE(values, nullptr);
+    EXPECT_EQ(*values, std::vector<int>({i, i + N_KEYS, i + N_KEYS * 2}));
+  }
+  m.find(0)->clear();
+  EXPECT_TRUE(m.get(0).empty());
+  EXPECT_EQ(m.get_or_insert(N_KEYS, {7}).size(), 1);
+  const auto& const_m = m;
+  EXPECT_EQ(const_m.find(N_KEYS + 1), nullptr);
+
+  fgpl::HashMap<std::string, int, fgpl::StringHasher> counts;
+  const char text[] = "abab";
+  for (int i = 0; i < 4; i += 2) counts.get_or_insert(fgpl::StringView(text + i, 2))++;
+  EXPECT_EQ(*counts.find(fgpl::StringView(text, 2)), 2);
+}
+
+template <class M>
+void test_allocator() {
+  M m;
+  constexpr long long N_KEYS = 300000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * 7, i);
+  for (long long i = 0; i < N_KEYS; i += 2) m.unset(i * 7);
+  M m2(m);
+  m.clear_and_shrink();
+  for (long long i = 0; i < N_KEYS; i++) EXPECT_EQ(m2.get(i * 7, -1), i % 2 == 0 ? -1 : i);
+}
+
+TEST(HashMapTest, HugePageAndPoolAllocators) {
+  test_allocator<fgpl::HashMap<
+      long long,
+      long long,
+      std::hash<long long>,
+      fgpl::PrimeCapacity,
+      fgpl::LinearProbing,
+      fgpl::HugePageAllocator>>();
+  test_allocator<fgpl::HashMap<
+      long long,
+      long long,
+      std::hash<long long>,
+      fgpl::PowerOfTwoCapacity,
+      fgpl::RobinHoodProbing,
+      fgpl::PoolAllocator>>();
+  EXPECT_GT(fgpl::BlockPool::get_instance().get_n_pooled_bytes(), 0);
+  const size_t n_pooled_bytes = fgpl::BlockPool::get_instance().get_n_pooled_bytes();
+  {
+    fgpl::HashMap<
+        int,
+        int,
+        std::hash<int>,
+        fgpl::PrimeCapacity,
+        fgpl::LinearProbing,
+        fgpl::PoolAllocator>
+        m;
+    m.set(1, 1);
+  }
+  EXPECT_EQ(fgpl::BlockPool::get_instance().get_n_pooled_bytes(), n_pooled_bytes);
+  fgpl::BlockPool::get_instance().release_all();
+  EXPECT_EQ(fgpl::BlockPool::get_instance().get_n_pooled_bytes(), 0);
+}
+
+TEST(HashMapTest, BlockPoolSizeClassesAndCap) {
+  fgpl::BlockPool& pool = fgpl::BlockPool::get_instance();
+  pool.release_all();
+  const size_t max_pooled_bytes = pool.get_max_pooled_bytes();
+  // 1000 and 1010 bytes share the 1024 byte class.
+  void* ptr = pool.acquire(1000);
+  pool.release(ptr, 1000);
+  EXPECT_EQ(pool.get_n_pooled_bytes(), 1024);
+  EXPECT_EQ(pool.acquire(1010), ptr);
+  EXPECT_EQ(pool.get_n_pooled_bytes(), 0);
+  pool.release(ptr, 1010);
+  pool.set_max_pooled_bytes(4096);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 8; i++) ptrs.push_back(pool.acquire(1024));
+  for (void* block : ptrs) pool.release(block, 1024);
+  EXPECT_EQ(pool.get_n_pooled_bytes(), 4096);
+  pool.set_max_pooled_bytes(2048);
+  EXPECT_EQ(pool.get_n_pooled_bytes(), 2048);
+  pool.set_max_pooled_bytes(max_pooled_bytes);
+  pool.release_all();
+  EXPECT_EQ(pool.get_n_pooled_bytes(), 0);
+}
+
+TEST(HashMapTest, ReseedClusteredKeys) {
+  fgpl::HashMap<long long, int> m;
+  m.reserve(100000);
+  const long long n_buckets = m.get_n_buckets();
+  int n_unbalanced_calls = 0;
+  m.unbalanced_handler = [&](const fgpl::HashStats& stats) {
+    EXPECT_GT(stats.n_reseeds, 0);
+    n_unbalanced_calls++;
+  };
+  // All the keys share the same home bucket under the identity hash and the prime capacity.
+  constexpr int N_KEYS = 2000;
+  for (int i = 0; i < N_KEYS; i++) m.set(i * n_buckets, i);
+  EXPECT_EQ(m.get_n_buckets(), n_buckets);
+  EXPECT_NE(m.get_seed(), 0);
+  EXPECT_GT(m.get_stats().n_reseeds, 0);
+  EXPECT_EQ(n_unbalanced_calls, m.get_stats().n_reseeds);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i * n_buckets, -1), i);
+  EXPECT_EQ(m.get(1, -1), -1);
+  m.set_seed(0);
+  EXPECT_EQ(m.get_seed(), 0);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i * n_buckets, -1), i);
+}
+
+TEST(HashMapTest, GetOrInsertAcrossReseed) {
+  fgpl::HashMap<long long, std::vector<int>> m;
+  m.reserve(100000);
+  const long long n_buckets = m.get_n_buckets();
+  m.unbalanced_handler = [](const fgpl::HashStats&) {};
+  constexpr int N_KEYS = 2000;
+  for (int i = 0; i < N_KEYS; i++) m.get_or_insert(i * n_buckets).push_back(i);
+  EXPECT_EQ(m.get_n_buckets(), n_buckets);
+  EXPECT_GT(m.get_stats().n_reseeds, 0);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i * n_buckets), std::vector<int>(1, i));
+}
+
+TEST(HashMapTest, EraseIfAndRetain) {
+  fgpl::HashMap<int, int> m;
+  m.incremental_rehash = true;
+  constexpr int N_KEYS = 10000;
+  int n_keys = 0;
+  while (n_keys < N_KEYS || !m.is_rehashing()) {
+    m.set(n_keys, n_keys);
+    n_keys++;
+  }
+  int n_calls = 0;
+  const size_t n_erased = m.erase_if([&](const int key, const size_t, const int value) {
+    n_calls++;
+    EXPECT_EQ(key, value);
+    return key % 3 == 0;
+  });
+  EXPECT_FALSE(m.is_rehashing());
+  EXPECT_EQ(n_calls, n_keys);
+  EXPECT_EQ(n_erased, static_cast<size_t>((n_keys + 2) / 3));
+  EXPECT_EQ(m.get_n_keys(), static_cast<size_t>(n_keys) - n_erased);
+  const auto& is_even = [](const int key, const size_t, const int) { return key % 2 == 0; };
+  size_t n_odd_keys = 0;
+  for (int i = 0; i < n_keys; i++) n_odd_keys += i % 3 != 0 && i % 2 == 1;
+  EXPECT_EQ(m.retain(is_even), n_odd_keys);
+  for (int i = 0; i < n_keys; i++) EXPECT_EQ(m.has(i), i % 3 != 0 && i % 2 == 0);
+}
+
+TEST(HashMapTest, EraseIfShrinksBelowMinLoadFactor) {
+  fgpl::HashMap<int, int, std::hash<int>, fgpl::PowerOfTwoCapacity, fgpl::RobinHoodProbing> m;
+  constexpr int N_KEYS = 100000;
+  for (int i = 0; i < N_KEYS; i++) m.set(i, i);
+  const size_t n_buckets = m.get_n_buckets();
+  m.erase_if([](const int key, const size_t, const int) { return key % 2 == 0; });
+  EXPECT_EQ(m.get_n_buckets(), n_buckets);
+  m.min_load_factor = 0.2f;
+  m.erase_if([](const int key, const size_t, const int) { return key % 10 != 1; });
+  EXPECT_EQ(m.get_n_keys(), N_KEYS / 10);
+  EXPECT_LT(m.get_n_buckets(), n_buckets / 4);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i, -1), i % 10 == 1 ? i : -1);
+  m.erase_if([](const int, const size_t, const int) { return true; });
+  EXPECT_EQ(m.get_n_keys(), 0);
+  EXPECT_EQ(m.get_n_buckets(), static_cast<size_t>(fgpl::PowerOfTwoCapacity::N_INITIAL_BUCKETS));
+}
+
+TEST(HashMapTest, CompactIntegralEntries) {
+  EXPECT_EQ(sizeof(fgpl::internal::hash::HashEntry<long long, double>), 16);
+  EXPECT_EQ(sizeof(fgpl::internal::hash::HashEntry<long long, void>), 8);
+  fgpl::HashMap<long long, double> m;
+  constexpr long long N_KEYS = 10000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  for (long long i = 0; i < N_KEYS; i += 2) m.unset(i * i);
+  for (long long i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(m.has(i * i), i % 2 == 1);
+    if (i % 2 == 1) {
+      EXPECT_EQ(m.get(i * i), i);
+    }
+  }
+  size_t n_keys = 0;
+  m.for_each([&](const long long key, const size_t hash_value, const double) {
+    EXPECT_EQ(hash_value, std::hash<long long>()(key));
+    n_keys++;
+  });
+  EXPECT_EQ(n_keys, N_KEYS / 2);
+}
+
 TEST(HashMapTest, Reserve) {
   fgpl::HashMap<std::string, int> m;
   m.reserve(100);
@@ -74,6 +306,220 @@ TEST(HashMapTest, LargeSetAndGetAutoRehash) {
   for (long long i = 0; i < N_KEYS; i += 10) EXPECT_EQ(m.get(i * i), i);
 }
 
+TEST(HashMapTest, LargeSetAndGetPowerOfTwoCapacity) {
+  fgpl::HashMap<long long, int, std::hash<long long>, fgpl::PowerOfTwoCapacity> m;
+  constexpr long long N_KEYS = 1000000;
+  m.reserve(N_KEYS);
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  for (long long i = 0; i < N_KEYS; i += 10) EXPECT_EQ(m.get(i * i), i);
+}
+
+TEST(HashMapTest, LargeSetAndGetPowerOfTwoCapacityAutoRehash) {
+  fgpl::HashMap<long long, int, std::hash<long long>, fgpl::PowerOfTwoCapacity> m;
+  constexpr long long N_KEYS = 1000000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  for (long long i = 0; i < N_KEYS; i += 10) EXPECT_EQ(m.get(i * i), i);
+  EXPECT_EQ(m.get_n_buckets() & (m.get_n_buckets() - 1), 0);
+}
+
+TEST(HashMapTest, RobinHoodProbingSetUnsetAndGet) {
+  fgpl::HashMap<long long, int, std::hash<long long>, fgpl::PrimeCapacity, fgpl::RobinHoodProbing>
+      m;
+  EXPECT_NEAR(m.max_load_factor, 0.9, 1.0e-6);
+  constexpr long long N_KEYS = 100000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  for (long long i = 0; i < N_KEYS; i += 3) m.unset(i * i);
+  for (long long i = 0; i < N_KEYS; i++) {
+    if (i % 3 == 0) {
+      EXPECT_FALSE(m.has(i * i));
+    } else {
+      EXPECT_EQ(m.get(i * i), i);
+    }
+  }
+  EXPECT_GE(m.get_n_buckets(), m.get_n_keys() / 0.9);
+}
+
+TEST(HashMapTest, GetManyAndHasMany) {
+  fgpl::HashMap<std::string, int> m;
+  constexpr int N_KEYS = 1000;
+  std::vector<std::string> keys(N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) {
+    keys[i] = std::to_string(i);
+    if (i % 3 == 0) m.set(keys[i], i);
+  }
+  std::vector<int> values(N_KEYS);
+  m.get_many(keys.data(), N_KEYS, values.data(), -1);
+  bool found[N_KEYS];
+  m.has_many(keys.data(), N_KEYS, found);
+  for (int i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(values[i], i % 3 == 0 ? i : -1);
+    EXPECT_EQ(found[i], i % 3 == 0);
+  }
+}
+
+TEST(HashMapTest, IncrementalRehash) {
+  fgpl::HashMap<std::string, int> m;
+  m.incremental_rehash = true;
+  constexpr int N_KEYS = 10000;
+  bool rehashing = false;
+  for (int i = 0; i < N_KEYS; i++) {
+    m.set(std::to_string(i), i);
+    if (m.is_rehashing()) rehashing = true;
+    if (i % 3 == 0) m.unset(std::to_string(i / 3));
+  }
+  EXPECT_TRUE(rehashing);
+  for (int i = 0; i < N_KEYS; i++) {
+    const bool unset = i * 3 < N_KEYS;
+    EXPECT_EQ(m.has(std::to_string(i)), !unset);
+    EXPECT_EQ(m.get(std::to_string(i), -1), unset ? -1 : i);
+  }
+  size_t n_keys = 0;
+  m.for_each([&](const std::string&, const size_t, const int) { n_keys++; });
+  EXPECT_EQ(n_keys, m.get_n_keys());
+  m.complete_rehash();
+  EXPECT_FALSE(m.is_rehashing());
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.has(std::to_string(i)), i * 3 >= N_KEYS);
+}
+
+TEST(HashMapTest, ForEachAndIterators) {
+  fgpl::HashMap<std::string, int, fgpl::ArenaStringHasher> m;
+  m.incremental_rehash = true;
+  EXPECT_TRUE(m.begin() == m.end());
+  constexpr int N_KEYS = 10000;
+  int i = 0;
+  while (i < N_KEYS || !m.is_rehashing()) {
+    m.set(std::to_string(i), i);
+    i++;
+  }
+  const int n_keys = i;
+  long long sum = 0;
+  m.for_each([&](const std::string&, const size_t, const int value) { sum += value; });
+  EXPECT_EQ(sum, static_cast<long long>(n_keys) * (n_keys - 1) / 2);
+  int n_visited = 0;
+  sum = 0;
+  fgpl::ArenaStringHasher hasher;
+  for (const auto& entry : m) {
+    EXPECT_EQ(entry.get_key(), std::to_string(entry.get_value()));
+    EXPECT_EQ(entry.get_hash_value(), hasher(entry.get_key()));
+    sum += entry.get_value();
+    n_visited++;
+  }
+  EXPECT_EQ(n_visited, n_keys);
+  EXPECT_EQ(sum, static_cast<long long>(n_keys) * (n_keys - 1) / 2);
+  const auto it = m.begin();
+  auto next = it;
+  EXPECT_TRUE(next++ == it);
+  EXPECT_TRUE(next != it);
+  EXPECT_EQ(std::distance(m.begin(), m.end()), n_keys);
+}
+
+template <class M>
+void test_parallel_rehash() {
+  M m;
+  constexpr long long N_KEYS = 200000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * 7919, i);
+  const int n_threads = omp_get_max_threads();
+  omp_set_num_threads(4);
+  m.reserve(N_KEYS * 4);
+  omp_set_num_threads(n_threads);
+  for (long long i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i * 7919, -1), i);
+  for (long long i = 0; i < N_KEYS; i += 2) m.unset(i * 7919);
+  for (long long i = 0; i < N_KEYS; i++) EXPECT_EQ(m.has(i * 7919), i % 2 == 1);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS / 2);
+}
+
+TEST(HashMapTest, ParallelRehash) {
+  test_parallel_rehash<fgpl::HashMap<long long, long long>>();
+  test_parallel_rehash<fgpl::HashMap<
+      long long,
+      long long,
+      std::hash<long long>,
+      fgpl::PowerOfTwoCapacity,
+      fgpl::RobinHoodProbing>>();
+}
+
+TEST(HashMapTest, ParallelRehashInSmallerTeam) {
+  // Dynamic adjustment gives teams of at most the number of processors, fewer than requested.
+  const int n_threads = omp_get_max_threads();
+  const int dynamic = omp_get_dynamic();
+  omp_set_num_threads(omp_get_num_procs() * 4);
+  omp_set_dynamic(1);
+  fgpl::HashMap<long long, long long> m;
+  constexpr long long N_KEYS = 300000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i, i);
+  omp_set_dynamic(dynamic);
+  omp_set_num_threads(n_threads);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  long long n_found_keys = 0;
+  for (long long i = 0; i < N_KEYS; i++) n_found_keys += m.get(i, -1) == i;
+  EXPECT_EQ(n_found_keys, N_KEYS);
+}
+
+TEST(HashMapTest, ArenaStringKeys) {
+  EXPECT_EQ(sizeof(fgpl::internal::hash::HashEntry<std::string, int, fgpl::ArenaStringHasher>), 24);
+  fgpl::HashMap<std::string, int, fgpl::ArenaStringHasher> m;
+  constexpr int N_KEYS = 10000;
+  for (int i = 0; i < N_KEYS; i++) m.set("key" + std::to_string(i), i);
+  for (int i = 0; i < N_KEYS; i += 2) m.unset("key" + std::to_string(i));
+  m.set("key1", N_KEYS, fgpl::Reducer<int>::sum);
+  fgpl::HashMap<std::string, int, fgpl::ArenaStringHasher> m2(m);
+  m.clear();
+  EXPECT_EQ(m.get_n_keys(), 0);
+  for (int i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(m2.get("key" + std::to_string(i), -1), i % 2 == 0 ? -1 : i == 1 ? N_KEYS + 1 : i);
+  }
+  size_t n_keys = 0;
+  m2.for_each([&](const std::string& key, const size_t, const int value) {
+    EXPECT_EQ(key, "key" + std::to_string(value % N_KEYS));
+    n_keys++;
+  });
+  EXPECT_EQ(n_keys, N_KEYS / 2);
+}
+
+TEST(HashMapTest, ArenaCompactedAfterErase) {
+  fgpl::HashMap<std::string, int, fgpl::ArenaStringHasher> m;
+  constexpr int N_KEYS = 10000;
+  for (int i = 0; i < N_KEYS; i++) m.set("key" + std::to_string(i), i);
+  const size_t n_key_bytes = m.get_n_key_bytes();
+  const size_t n_erased = m.erase_if([](const std::string&, const size_t, const int value) {
+    return value % 10 != 0;
+  });
+  EXPECT_EQ(n_erased, N_KEYS - N_KEYS / 10);
+  EXPECT_LT(m.get_n_key_bytes(), n_key_bytes / 5);
+  for (int i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(m.get("key" + std::to_string(i), -1), i % 10 == 0 ? i : -1);
+  }
+  for (int i = 0; i < N_KEYS; i += 10) m.unset("key" + std::to_string(i));
+  for (int i = 0; i < 10; i++) m.set("key" + std::to_string(i), i);
+  m.shrink_to_fit();
+  EXPECT_EQ(m.get_n_key_bytes(), 40);
+  for (int i = 0; i < 10; i++) EXPECT_EQ(m.get("key" + std::to_string(i), -1), i);
+}
+
+TEST(HashMapTest, StringViewLookupsAndUpdates) {
+  fgpl::HashMap<std::string, int, fgpl::StringHasher> m;
+  const char text[] = "abcabc";
+  const fgpl::StringView abc(text, 3);
+  EXPECT_EQ(fgpl::StringHasher()(abc), fgpl::StringHasher()(std::string("abc")));
+  EXPECT_FALSE(m.has(abc));
+  m.set(abc, 1, fgpl::Reducer<int>::sum);
+  m.set(fgpl::StringView(text + 3, 3), 1, fgpl::Reducer<int>::sum);
+  EXPECT_EQ(m.get_n_keys(), 1);
+  EXPECT_TRUE(m.has("abc"));
+  EXPECT_EQ(m.get(abc), 2);
+  EXPECT_EQ(m.get(fgpl::StringView(text, 2), -1), -1);
+  m.set("ab", 5);
+  EXPECT_EQ(m.get(fgpl::StringView(text, 2)), 5);
+
+  fgpl::HashMap<std::string, int, fgpl::ArenaStringHasher> arena_m;
+  for (int i = 0; i < 1000; i++) {
+    const std::string key = std::to_string(i % 100);
+    arena_m.set(fgpl::StringView(key), 1, fgpl::Reducer<int>::sum);
+  }
+  EXPECT_EQ(arena_m.get_n_keys(), 100);
+  EXPECT_EQ(arena_m.get(fgpl::StringView("42")), 10);
+}
+
 TEST(HashMapTest, UnsetAndHas) {
   fgpl::HashMap<std::string, int> m;
   m.set("aa", 1);
@@ -106,3 +552,18 @@ TEST(HashMapTest, ClearAndShrink) {
   m.clear_and_shrink();
   EXPECT_LT(m.get_n_buckets(), N_KEYS * m.max_load_factor);
 }
+
+TEST(HashMapTest, LargeSetUnsetAndGet) {
+  fgpl::HashMap<long long, int> m;
+  constexpr long long N_KEYS = 100000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  for (long long i = 0; i < N_KEYS; i += 2) m.unset(i * i);
+  EXPECT_EQ(m.get_n_keys(), N_KEYS / 2);
+  for (long long i = 0; i < N_KEYS; i++) {
+    if (i % 2 == 0) {
+      EXPECT_FALSE(m.has(i * i));
+    } else {
+      EXPECT_EQ(m.get(i * i), i);
+    }
+  }
+}
@@ -1,4 +1,5 @@
 #include "../hash_set.h"
+#include "../string_view.h"
 
 #include <gtest/gtest.h>
 #include <string>
@@ -9,6 +10,53 @@ TEST(HashSetTest, Initialization) {
   EXPECT_EQ(m.get_n_keys(), 0);
 }
 
+TEST(HashSetTest, MoveSet) {
+  fgpl::HashSet<std::string> m;
+  std::string key = "aa";
+  m.set(std::move(key));
+  EXPECT_TRUE(m.has("aa"));
+  for (int i = 0; i < 1000; i++) m.set(std::to_string(i));
+  for (int i = 0; i < 1000; i++) EXPECT_TRUE(m.has(std::to_string(i)));
+  EXPECT_EQ(m.get_n_keys(), 1001);
+}
+
+TEST(HashSetTest, HasMany) {
+  fgpl::HashSet<int> m;
+  constexpr int N_KEYS = 1000;
+  int keys[N_KEYS];
+  for (int i = 0; i < N_KEYS; i++) {
+    keys[i] = i;
+    if (i % 4 == 1) m.set(i);
+  }
+  bool found[N_KEYS];
+  m.has_many(keys, N_KEYS, found);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(found[i], i % 4 == 1);
+}
+
+TEST(HashSetTest, StringViewSetAndHas) {
+  fgpl::HashSet<std::string, fgpl::StringHasher> m;
+  const std::string text = "hello world";
+  m.set(fgpl::StringView(text.data(), 5));
+  EXPECT_TRUE(m.has("hello"));
+  EXPECT_TRUE(m.has(fgpl::StringView(text.data(), 5)));
+  EXPECT_FALSE(m.has(fgpl::StringView(text.data() + 6, 5)));
+}
+
+TEST(HashSetTest, Iterators) {
+  fgpl::HashSet<int> s;
+  for (int i = 0; i < 1000; i++) s.set(i * 3);
+  for (int i = 0; i < 1000; i += 2) s.unset(i * 3);
+  int n_keys = 0;
+  for (const auto& entry : s) {
+    EXPECT_EQ(entry.get_key() % 6, 3);
+    n_keys++;
+  }
+  EXPECT_EQ(n_keys, 500);
+  int key_sum = 0;
+  s.for_each([&](const int key, const size_t) { key_sum += key; });
+  EXPECT_EQ(key_sum, 3 * 500 * 500);
+}
+
 TEST(HashSetTest, CopyConstructor) {
   fgpl::HashSet<std::string> m;
   m.set("aa");
@@ -84,6 +132,35 @@ TEST(HashSetTest, LargeSetAndHasAutoRehash) {
   for (int i = 0; i < N_KEYS; i += 10) EXPECT_TRUE(m.has(i * i));
 }
 
+TEST(HashSetTest, LargeSetAndHasPowerOfTwoCapacityAutoRehash) {
+  fgpl::HashSet<int, std::hash<int>, fgpl::PowerOfTwoCapacity> m;
+  constexpr int N_KEYS = 1000000;
+  for (int i = 0; i < N_KEYS; i++) m.set(i * i);
+  for (int i = 0; i < N_KEYS; i += 10) EXPECT_TRUE(m.has(i * i));
+}
+
+TEST(HashSetTest, RobinHoodProbingSetUnsetAndHas) {
+  fgpl::HashSet<std::string, std::hash<std::string>, fgpl::PrimeCapacity, fgpl::RobinHoodProbing>
+      m;
+  constexpr int N_KEYS = 10000;
+  for (int i = 0; i < N_KEYS; i++) m.set(std::to_string(i));
+  for (int i = 0; i < N_KEYS; i += 2) m.unset(std::to_string(i));
+  EXPECT_EQ(m.get_n_keys(), N_KEYS / 2);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.has(std::to_string(i)), i % 2 == 1);
+}
+
+TEST(HashSetTest, EraseIfAndRetain) {
+  fgpl::HashSet<std::string, std::hash<std::string>, fgpl::PrimeCapacity, fgpl::RobinHoodProbing>
+      m;
+  constexpr int N_KEYS = 10000;
+  for (int i = 0; i < N_KEYS; i++) m.set(std::to_string(i));
+  EXPECT_EQ(m.erase_if([](const std::string& key, const size_t) { return key.back() == '0'; }),
+            N_KEYS / 10);
+  m.retain([](const std::string& key, const size_t) { return key.size() < 4; });
+  EXPECT_EQ(m.get_n_keys(), 900);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.has(std::to_string(i)), i % 10 != 0 && i < 1000);
+}
+
 TEST(HashSetTest, UnsetAndHas) {
   fgpl::HashSet<std::string> m;
   m.set("aa");
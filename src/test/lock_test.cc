@@ -0,0 +1,78 @@
+#include "../lock.h"
+
+#include <gtest/gtest.h>
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+template <class L>
+void expect_mutual_exclusion() {
+  L lock;
+  constexpr long long N_INCREMENTS = 200000;
+  long long count = 0;
+#pragma omp parallel for
+  for (long long i = 0; i < N_INCREMENTS; i++) {
+    std::lock_guard<L> guard(lock);
+    count++;
+  }
+  EXPECT_EQ(count, N_INCREMENTS);
+}
+
+template <class L>
+void expect_try_lock() {
+  L lock;
+  EXPECT_TRUE(lock.try_lock());
+  EXPECT_FALSE(lock.try_lock());
+  lock.unlock();
+  lock.lock();
+  EXPECT_FALSE(lock.try_lock());
+  lock.unlock();
+  EXPECT_TRUE(lock.try_lock());
+  lock.unlock();
+}
+}  // namespace
+
+TEST(LockTest, OmpLock) {
+  expect_mutual_exclusion<fgpl::OmpLock>();
+  expect_try_lock<fgpl::OmpLock>();
+}
+
+TEST(LockTest, SpinLock) {
+  expect_mutual_exclusion<fgpl::SpinLock>();
+  expect_try_lock<fgpl::SpinLock>();
+}
+
+TEST(LockTest, TicketLock) {
+  expect_mutual_exclusion<fgpl::TicketLock>();
+  expect_try_lock<fgpl::TicketLock>();
+}
+
+TEST(LockTest, FutexLock) {
+  expect_mutual_exclusion<fgpl::FutexLock>();
+  expect_try_lock<fgpl::FutexLock>();
+}
+
+TEST(LockTest, ThreadIndexUniqueAmongLiveThreads) {
+  constexpr size_t N_THREADS = 8;
+  std::vector<size_t> indices(N_THREADS);
+  std::atomic<size_t> n_ready(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < N_THREADS; i++) {
+    threads.emplace_back([&, i]() {
+      indices[i] = fgpl::internal::ThreadIndex::get();
+      n_ready++;
+      // All the threads are alive while the indices are taken.
+      while (n_ready < N_THREADS) std::this_thread::yield();
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(std::set<size_t>(indices.begin(), indices.end()).size(), N_THREADS);
+  size_t reused_index = 0;
+  std::thread([&]() { reused_index = fgpl::internal::ThreadIndex::get(); }).join();
+  EXPECT_LE(reused_index, *std::max_element(indices.begin(), indices.end()));
+}
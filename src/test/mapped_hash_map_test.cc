@@ -0,0 +1,85 @@
+#include "../mapped_hash_map.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include "../hash_map.h"
+#include "../string_arena.h"
+#include "../string_view.h"
+
+namespace {
+std::string get_temp_path(const std::string& name) {
+  return "/tmp/fgpl_" + name + "_" + std::to_string(getpid()) + ".bin";
+}
+}  // namespace
+
+TEST(MappedHashMapTest, SaveAndMap) {
+  const std::string path = get_temp_path("mapped_hash_map");
+  fgpl::HashMap<long long, double> m;
+  constexpr long long N_KEYS = 100000;
+  for (long long i = 0; i < N_KEYS; i++) m.set(i * i, i);
+  for (long long i = 0; i < N_KEYS; i += 3) m.unset(i * i);
+  m.save(path);
+  fgpl::MappedHashMap<long long, double> mapped(path);
+  EXPECT_EQ(mapped.get_n_keys(), m.get_n_keys());
+  EXPECT_EQ(mapped.get_n_buckets(), m.get_n_buckets());
+  for (long long i = 0; i < N_KEYS; i++) {
+    EXPECT_EQ(mapped.has(i * i), i % 3 != 0);
+    EXPECT_EQ(mapped.get(i * i, -1), i % 3 != 0 ? i : -1);
+  }
+  EXPECT_FALSE(mapped.has(2));
+  std::remove(path.c_str());
+}
+
+TEST(MappedHashMapTest, SaveDuringIncrementalRehash) {
+  const std::string path = get_temp_path("mapped_hash_map_incremental");
+  fgpl::HashMap<int, int, std::hash<int>, fgpl::PowerOfTwoCapacity, fgpl::RobinHoodProbing> m;
+  m.incremental_rehash = true;
+  constexpr int N_KEYS = 10000;
+  int i = 0;
+  while (i < N_KEYS || !m.is_rehashing()) {
+    m.set(i, i * 2);
+    i++;
+  }
+  const int n_keys = i;
+  m.save(path);
+  EXPECT_TRUE(m.is_rehashing());
+  fgpl::MappedHashMap<int, int, std::hash<int>, fgpl::PowerOfTwoCapacity, fgpl::RobinHoodProbing>
+      mapped(path);
+  EXPECT_EQ(mapped.get_n_keys(), n_keys);
+  for (int j = 0; j < n_keys + 10; j++) EXPECT_EQ(mapped.get(j, -1), j < n_keys ? j * 2 : -1);
+  EXPECT_THROW((fgpl::MappedHashMap<int, int>(path)), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(MappedHashMapTest, ArenaStringKeys) {
+  const std::string path = get_temp_path("mapped_hash_map_strings");
+  fgpl::HashMap<std::string, int, fgpl::ArenaStringHasher> m;
+  constexpr int N_KEYS = 10000;
+  for (int i = 0; i < N_KEYS; i++) m.set("key" + std::to_string(i), i);
+  m.save(path);
+  fgpl::MappedHashMap<std::string, int, fgpl::ArenaStringHasher> mapped(path);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(mapped.get("key" + std::to_string(i), -1), i);
+  const char text[] = "key12x";
+  EXPECT_EQ(mapped.get(fgpl::StringView(text, 5)), 12);
+  EXPECT_FALSE(mapped.has(fgpl::StringView(text, 6)));
+  std::remove(path.c_str());
+}
+
+TEST(MappedHashMapTest, CapacityMismatch) {
+  const std::string path = get_temp_path("mapped_hash_map_capacity");
+  fgpl::HashMap<int, int> m;
+  for (int i = 0; i < 1000; i++) m.set(i, i);
+  m.save(path);
+  EXPECT_THROW(
+      (fgpl::MappedHashMap<int, int, std::hash<int>, fgpl::PowerOfTwoCapacity>(path)),
+      std::runtime_error);
+  EXPECT_EQ((fgpl::MappedHashMap<int, int>(path).get(999, -1)), 999);
+  std::remove(path.c_str());
+}
+
+TEST(MappedHashMapTest, MissingFile) {
+  EXPECT_THROW((fgpl::MappedHashMap<int, int>("/nonexistent/fgpl.bin")), std::runtime_error);
+}
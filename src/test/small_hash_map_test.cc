@@ -0,0 +1,73 @@
+#include "../small_hash_map.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include "../dist_range.h"
+
+TEST(SmallHashMapTest, Initialization) {
+  fgpl::SmallHashMap<std::string, int> m;
+  EXPECT_EQ(m.get_n_keys(), 0);
+  EXPECT_FALSE(m.is_spilled());
+}
+
+TEST(SmallHashMapTest, SetAndGetInline) {
+  fgpl::SmallHashMap<std::string, int, 4> m;
+  m.set("aa", 1);
+  m.set("bb", 2);
+  m.set("aa", 3, fgpl::Reducer<int>::sum);
+  m.set("cc", 5);
+  m.set("dd", 6);
+  EXPECT_FALSE(m.is_spilled());
+  EXPECT_EQ(m.get_n_keys(), 4);
+  EXPECT_EQ(m.get("aa"), 4);
+  EXPECT_EQ(m.get("bb"), 2);
+  EXPECT_EQ(m.get("ee", -1), -1);
+  EXPECT_FALSE(m.has("ee"));
+}
+
+TEST(SmallHashMapTest, SpillToHashMap) {
+  fgpl::SmallHashMap<int, int, 8> m;
+  constexpr int N_KEYS = 1000;
+  for (int i = 0; i < N_KEYS; i++) m.set(i, i);
+  for (int i = 0; i < N_KEYS; i++) m.set(i, 1, fgpl::Reducer<int>::sum);
+  EXPECT_TRUE(m.is_spilled());
+  EXPECT_EQ(m.get_n_keys(), N_KEYS);
+  for (int i = 0; i < N_KEYS; i++) EXPECT_EQ(m.get(i), i + 1);
+  long long sum = 0;
+  m.for_each([&](const int, const size_t, const int value) { sum += value; });
+  EXPECT_EQ(sum, static_cast<long long>(N_KEYS) * (N_KEYS + 1) / 2);
+  const auto copy = m;
+  m.clear();
+  EXPECT_FALSE(m.is_spilled());
+  EXPECT_EQ(m.get_n_keys(), 0);
+  EXPECT_EQ(copy.get(N_KEYS - 1), N_KEYS);
+}
+
+TEST(SmallHashMapTest, UnsetAndHas) {
+  fgpl::SmallHashMap<int, int, 8> m;
+  for (int i = 0; i < 8; i++) m.set(i, i);
+  m.unset(0);
+  m.unset(7);
+  m.unset(100);
+  EXPECT_EQ(m.get_n_keys(), 6);
+  for (int i = 0; i < 8; i++) EXPECT_EQ(m.has(i), i != 0 && i != 7);
+  m.set(8, 8);
+  m.set(9, 9);
+  EXPECT_FALSE(m.is_spilled());
+  EXPECT_EQ(m.get(9), 9);
+}
+
+TEST(SmallHashMapTest, PerTaskAggregation) {
+  fgpl::DistRange<int> range(0, 100);
+  fgpl::DistHashMap<int, int> dm;
+  const auto& mapper = [&](const int i, const std::function<void(const int&, const int&)>& emit) {
+    fgpl::SmallHashMap<int, int, 4> counts;
+    for (int j = 0; j < 10; j++) counts.set((i + j) % 3, 1, fgpl::Reducer<int>::sum);
+    counts.for_each([&](const int key, const size_t, const int count) { emit(key, count); });
+  };
+  range.mapreduce<int, int, std::hash<int>>(mapper, fgpl::Reducer<int>::sum, dm);
+  int n_total = 0;
+  dm.for_each_serial([&](const int, const size_t, const int count) { n_total += count; });
+  EXPECT_EQ(n_total, 1000);
+  EXPECT_EQ(dm.get_n_keys(), 3);
+}